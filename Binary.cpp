@@ -0,0 +1,202 @@
+#include "Binary.h"
+
+#include <bit>
+#include <cstring>
+
+namespace
+{
+	constexpr char binary_magic[8] = { 'L', 'N', 'B', 'I', 'N', 0, 0, 1 };
+
+	constexpr uint64_t negative_flag = 1;
+	constexpr uint64_t nan_flag = 2;
+	constexpr int flag_bits = 2;
+
+	inline uint64_t Header(size_t limbs, bool negative, bool nan)
+	{
+		return static_cast< uint64_t >(limbs) << flag_bits | (negative ? negative_flag : 0) | (nan ? nan_flag : 0);
+	}
+
+	inline uint64_t LoadLE(const char *p)
+	{
+		unsigned char bytes[8];
+		std::memcpy(bytes, p, 8);
+		if constexpr (std::endian::native == std::endian::little)
+		{
+			uint64_t word;
+			std::memcpy(&word, bytes, 8);
+			return word;
+		}
+		uint64_t word = 0;
+		for (int i = 8; i-- > 0;)
+		{
+			word = word << 8 | bytes[i];
+		}
+		return word;
+	}
+
+	inline void StoreLE(char *p, uint64_t word)
+	{
+		if constexpr (std::endian::native == std::endian::little)
+		{
+			std::memcpy(p, &word, 8);
+			return;
+		}
+		for (int i = 0; i < 8; ++i)
+		{
+			p[i] = static_cast< char >(word >> (8 * i));
+		}
+	}
+
+	// 64-bit limb i of blocks[0, n)
+	template< typename Block >
+	uint64_t Limb(const Block *blocks, size_t n, size_t i)
+	{
+		if constexpr (sizeof(Block) == sizeof(uint64_t))
+		{
+			return blocks[i];
+		}
+		else
+		{
+			uint64_t high = 2 * i + 1 < n ? blocks[2 * i + 1] : 0;
+			return high << 32 | blocks[2 * i];
+		}
+	}
+
+	// on little-endian hosts with 64-bit blocks the limbs are the blocks
+	template< typename Block >
+	constexpr bool limbs_are_blocks = std::endian::native == std::endian::little && sizeof(Block) == sizeof(uint64_t);
+}	 // namespace
+
+// a NaN is only its header, whatever blocks a failed operation left in it
+size_t LN::BinarySize() const
+{
+	size_t n = is_nan_ ? 0 : data_.get_size();
+	return 8 * (1 + (n * sizeof(Block) + 7) / 8);
+}
+
+char *LN::WriteBinary(char *out) const
+{
+	size_t n = is_nan_ ? 0 : data_.get_size();
+	size_t limbs = (n * sizeof(Block) + 7) / 8;
+	StoreLE(out, Header(limbs, sign_ == -1 && !is_nan_, is_nan_));
+	out += 8;
+	if constexpr (limbs_are_blocks< Block >)
+	{
+		std::memcpy(out, data_.get_data(), n * sizeof(Block));
+		return out + n * sizeof(Block);
+	}
+	for (size_t i = 0; i < limbs; ++i, out += 8)
+	{
+		StoreLE(out, Limb(data_.get_data(), n, i));
+	}
+	return out;
+}
+
+void LN::WriteBinary(std::ostream &out) const
+{
+	size_t n = is_nan_ ? 0 : data_.get_size();
+	size_t limbs = (n * sizeof(Block) + 7) / 8;
+	char header[8];
+	StoreLE(header, Header(limbs, sign_ == -1 && !is_nan_, is_nan_));
+	out.write(header, 8);
+	if constexpr (limbs_are_blocks< Block >)
+	{
+		out.write(reinterpret_cast< const char * >(data_.get_data()),
+				  static_cast< std::streamsize >(n * sizeof(Block)));
+		return;
+	}
+
+	// the limbs are converted through a fixed buffer
+	constexpr size_t buffer_limbs = 512;
+	char buffer[buffer_limbs * 8];
+	for (size_t from = 0; from < limbs; from += buffer_limbs)
+	{
+		size_t count = std::min(buffer_limbs, limbs - from);
+		for (size_t i = 0; i < count; ++i)
+		{
+			StoreLE(buffer + 8 * i, Limb(data_.get_data(), n, from + i));
+		}
+		out.write(buffer, static_cast< std::streamsize >(8 * count));
+	}
+}
+
+const char *LN::ReadBinary(const char *begin, const char *end, LN &value)
+{
+	if (end - begin < 8)
+	{
+		return nullptr;
+	}
+	uint64_t header = LoadLE(begin);
+	uint64_t limbs = header >> flag_bits;
+	begin += 8;
+	if (limbs > static_cast< uint64_t >(end - begin) / 8 || ((header & nan_flag) && limbs != 0))
+	{
+		return nullptr;
+	}
+
+	value.is_nan_ = (header & nan_flag) != 0;
+	value.sign_ = (header & negative_flag) ? -1 : 1;
+	size_t n = limbs * 8 / sizeof(Block);
+	value.data_.resize_uninitialized(n);
+	Block *data = value.data_.get_data();
+	if constexpr (limbs_are_blocks< Block >)
+	{
+		std::memcpy(data, begin, n * sizeof(Block));
+	}
+	else
+	{
+		for (size_t i = 0; i < limbs; ++i)
+		{
+			uint64_t limb = LoadLE(begin + 8 * i);
+			for (size_t j = 0; j < 8 / sizeof(Block); ++j)
+			{
+				data[i * 8 / sizeof(Block) + j] = static_cast< Block >(limb >> (j * bits_in_block_));
+			}
+		}
+	}
+	// a 32-bit number ends in a zero half limb, and a writer may pad
+	value.Normalize();
+	if (value.data_.get_size() == 0)
+	{
+		value.sign_ = 1;
+	}
+	return begin + 8 * limbs;
+}
+
+BinaryReader::BinaryReader(std::string_view bytes) : pos_(bytes.data()), end_(bytes.data() + bytes.size())
+{
+	valid_ = bytes.size() >= sizeof(binary_magic) && std::memcmp(pos_, binary_magic, sizeof(binary_magic)) == 0;
+	pos_ = valid_ ? pos_ + sizeof(binary_magic) : end_;
+}
+
+bool BinaryReader::Next(LN &value)
+{
+	if (pos_ == end_)
+	{
+		return false;
+	}
+	const char *next = LN::ReadBinary(pos_, end_, value);
+	if (next == nullptr)
+	{
+		valid_ = false;
+		pos_ = end_;
+		return false;
+	}
+	pos_ = next;
+	return true;
+}
+
+bool BinaryReader::IsValid() const
+{
+	return valid_;
+}
+
+BinaryWriter::BinaryWriter(OutputWriter &out) : out_(out)
+{
+	out_.Write({ binary_magic, sizeof(binary_magic) });
+}
+
+void BinaryWriter::Write(const LN &value)
+{
+	out_.Commit(value.WriteBinary(out_.Reserve(value.BinarySize())));
+}
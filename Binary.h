@@ -0,0 +1,43 @@
+#pragma once
+
+#include "LN.h"
+#include "OutputWriter.h"
+
+#include <string_view>
+
+/*
+ * A sequence of LN values in binary: an 8-byte magic, then the values back
+ * to back in the form of LN::WriteBinary. Everything is a multiple of 8 bytes
+ * long, so the limbs of a memory-mapped file stay aligned. main writes its
+ * stack this way with --binary, top first, and reads it back with --load.
+ */
+
+// checks the magic, then hands out the values
+class BinaryReader
+{
+  public:
+	// bytes must outlive the reader, e.g. InputReader::Contents()
+	explicit BinaryReader(std::string_view bytes);
+
+	// the next value; false at the end and on a damaged record
+	bool Next(LN &value);
+	// false if the magic was missing or a record was damaged
+	bool IsValid() const;
+
+  private:
+	const char *pos_;
+	const char *end_;
+	bool valid_;
+};
+
+// writes the magic first
+class BinaryWriter
+{
+  public:
+	explicit BinaryWriter(OutputWriter &out);
+
+	void Write(const LN &value);
+
+  private:
+	OutputWriter &out_;
+};
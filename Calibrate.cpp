@@ -0,0 +1,156 @@
+#include "LN.h"
+
+#include <chrono>
+#include <random>
+
+namespace
+{
+	// best of several runs, in seconds per call of op
+	template< typename FN >
+	double Time(FN &&op)
+	{
+		using Clock = std::chrono::steady_clock;
+		double best = std::numeric_limits< double >::max();
+		for (int run = 0; run < 5; ++run)
+		{
+			size_t reps = 0;
+			auto start = Clock::now();
+			std::chrono::duration< double > elapsed{};
+			do
+			{
+				op();
+				++reps;
+				elapsed = Clock::now() - start;
+			} while (elapsed.count() < 0.01);
+			best = std::min(best, elapsed.count() / reps);
+		}
+		return best;
+	}
+
+	// first size in [from, to) where the faster algorithm wins twice in a row
+	template< typename FN >
+	size_t FindCrossover(size_t from, size_t to, std::ostream &log, const char *name, FN &&measure)
+	{
+		int wins = 0;
+		for (size_t n = from; n < to; n += std::max< size_t >(1, n / 8))
+		{
+			auto [slow, fast] = measure(n);
+			log << name << " n=" << n << " without=" << slow * 1e6 << "us with=" << fast * 1e6 << "us\n";
+			if (fast < slow)
+			{
+				if (++wins == 2)
+				{
+					return n;
+				}
+			}
+			else
+			{
+				wins = 0;
+			}
+		}
+		return to;
+	}
+}	 // namespace
+
+LN::Tuning LN::Calibrate(std::ostream &log)
+{
+	std::mt19937_64 rng(42);
+	auto random_number = [&rng](size_t blocks)
+	{
+		LN result;
+		result.data_.resize(blocks);
+		for (size_t i = 0; i < blocks; ++i)
+		{
+			result.data_[i] = static_cast< Block >(rng());
+		}
+		result.data_[blocks - 1] |= 1;
+		return result;
+	};
+
+	Tuning saved = tuning;
+	Tuning tuned = tuning;
+
+	// every comparison differs only in the algorithm used at the top level:
+	// a threshold of n + 1 keeps the lower algorithm for size n, a threshold
+	// of n switches it while all recursive calls stay below the threshold
+	auto compare = [&](size_t n, size_t Tuning::*threshold, bool square)
+	{
+		LN a = random_number(n);
+		LN b = square ? a : random_number(n);
+		const LN &rhs = square ? a : b;
+		auto multiply = [&] { LN product = a * rhs; };
+		tuning = tuned;
+		tuning.*threshold = n + 1;
+		double slow = Time(multiply);
+		tuning.*threshold = n;
+		double fast = Time(multiply);
+		return std::pair{ slow, fast };
+	};
+
+	struct Step
+	{
+		const char *name;
+		size_t Tuning::*threshold;
+		size_t Tuning::*previous;
+		bool square;
+		size_t limit;
+	};
+	const Step steps[] = {
+		{ "karatsuba_threshold", &Tuning::karatsuba_threshold, nullptr, false, 512 },
+		{ "toom3_threshold", &Tuning::toom3_threshold, &Tuning::karatsuba_threshold, false, 4096 },
+		{ "toom4_threshold", &Tuning::toom4_threshold, &Tuning::toom3_threshold, false, 8192 },
+		{ "ntt_threshold", &Tuning::ntt_threshold, &Tuning::toom4_threshold, false, 1 << 16 },
+		{ "karatsuba_sqr_threshold", &Tuning::karatsuba_sqr_threshold, nullptr, true, 512 },
+		{ "toom3_sqr_threshold", &Tuning::toom3_sqr_threshold, &Tuning::karatsuba_sqr_threshold, true, 4096 },
+		{ "toom4_sqr_threshold", &Tuning::toom4_sqr_threshold, &Tuning::toom3_sqr_threshold, true, 8192 },
+		{ "ntt_sqr_threshold", &Tuning::ntt_sqr_threshold, &Tuning::toom4_sqr_threshold, true, 1 << 16 },
+	};
+
+	// the higher algorithms stay off until their own step
+	for (const Step &step : steps)
+	{
+		if (step.previous != nullptr)
+		{
+			tuned.*step.threshold = std::numeric_limits< size_t >::max();
+		}
+	}
+	for (const Step &step : steps)
+	{
+		size_t from = step.previous == nullptr ? 4 : tuned.*step.previous + 1;
+		tuned.*step.threshold = FindCrossover(
+			from,
+			step.limit,
+			log,
+			step.name,
+			[&](size_t n) { return compare(n, step.threshold, step.square); });
+	}
+
+	// division by an n-block divisor with an n-block quotient, on top of the
+	// multiplication thresholds just found
+	tuned.burnikel_ziegler_threshold = FindCrossover(
+		4,
+		1024,
+		log,
+		"burnikel_ziegler_threshold",
+		[&](size_t n)
+		{
+			LN a = random_number(2 * n);
+			LN b = random_number(n);
+			auto divide = [&] { LN quotient = a / b; };
+			tuning = tuned;
+			tuning.burnikel_ziegler_threshold = n + 1;
+			double slow = Time(divide);
+			tuning.burnikel_ziegler_threshold = n;
+			double fast = Time(divide);
+			return std::pair{ slow, fast };
+		});
+
+	tuning = saved;
+	for (const Step &step : steps)
+	{
+		log << step.name << " = " << tuned.*step.threshold << "\n";
+	}
+	log << "burnikel_ziegler_threshold = " << tuned.burnikel_ziegler_threshold << "\n";
+	log.flush();
+	return tuned;
+}
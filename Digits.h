@@ -0,0 +1,31 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// digits of the text forms, shared by the hex (Hex.cpp) and the radix
+// (Radix.cpp) conversions
+
+// value of a digit in any base up to 36, letters of either case; 0xff for
+// other characters
+inline constexpr std::array< uint8_t, 256 > digit_value = []
+{
+	std::array< uint8_t, 256 > table{};
+	for (auto &v : table)
+	{
+		v = 0xff;
+	}
+	for (int i = 0; i < 10; ++i)
+	{
+		table['0' + i] = static_cast< uint8_t >(i);
+	}
+	for (int i = 0; i < 26; ++i)
+	{
+		table['A' + i] = static_cast< uint8_t >(10 + i);
+		table['a' + i] = static_cast< uint8_t >(10 + i);
+	}
+	return table;
+}();
+
+// upper case, the first 16 are the hex digits
+inline constexpr char digit_chars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
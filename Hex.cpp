@@ -0,0 +1,381 @@
+#include "Digits.h"
+#include "LN.h"
+
+#include <array>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#	define LN_HEX_X86 1
+#	include <immintrin.h>
+#	if defined(_MSC_VER) && !defined(__clang__)
+#		include <intrin.h>
+#		define LN_TARGET(isa)
+#	else
+#		include <cpuid.h>
+#		define LN_TARGET(isa) __attribute__((target(isa)))
+#	endif
+#endif
+
+/*
+ * Hex parsing in 16-digit words: each word becomes 64 bits of the number,
+ * the last 16 characters of the string being word 0. The vector kernels turn
+ * the characters into nibbles with range checks instead of a table, reverse
+ * them so the least significant digit comes first, and merge pairs of
+ * nibbles into bytes with one multiply-add. Printing runs the other way,
+ * with the digit characters looked up by a byte shuffle.
+ */
+
+namespace
+{
+	template< typename Block >
+	inline void StoreWord(Block *out, size_t i, uint64_t word)
+	{
+		if constexpr (sizeof(Block) == sizeof(uint64_t))
+		{
+			out[i] = word;
+		}
+		else
+		{
+			out[2 * i] = static_cast< Block >(word);
+			out[2 * i + 1] = static_cast< Block >(word >> 32);
+		}
+	}
+
+	// the digits in [begin, end), at most 16; bad collects the high bit of
+	// every invalid character
+	inline uint64_t ParseShort(const char *begin, const char *end, uint8_t &bad)
+	{
+		uint64_t word = 0;
+		for (const char *p = begin; p < end; ++p)
+		{
+			uint8_t v = digit_value[static_cast< unsigned char >(*p)];
+			bad |= v > 0xf ? 0x80 : 0;
+			word = word << 4 | (v & 0xf);
+		}
+		return word;
+	}
+
+	// words 16-digit words ending at end go to out, false on an invalid digit
+	template< typename Block >
+	bool ParseScalar(const char *end, size_t words, Block *out)
+	{
+		uint8_t bad = 0;
+		for (size_t i = 0; i < words; ++i)
+		{
+			StoreWord(out, i, ParseShort(end - 16 * (i + 1), end - 16 * i, bad));
+		}
+		return (bad & 0x80) == 0;
+	}
+
+#ifdef LN_HEX_X86
+	// nibble values of the 16 characters, valid marks the hex digits with 0xff
+	LN_TARGET("ssse3")
+	inline __m128i Nibbles128(__m128i c, __m128i &valid)
+	{
+		__m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+		// 'A'-'F' and 'a'-'f' meet at 'a'-'f', digits are checked on c itself
+		__m128i alpha = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+		__m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+		__m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+		valid = _mm_and_si128(valid, _mm_or_si128(is_digit, is_alpha));
+		return _mm_or_si128(
+			_mm_and_si128(is_digit, digit),
+			_mm_and_si128(is_alpha, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+	}
+
+	// 16 characters, most significant first, to their 64-bit value
+	LN_TARGET("ssse3")
+	inline uint64_t Word128(const char *p, __m128i &valid)
+	{
+		const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+		__m128i c = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast< const __m128i * >(p)), reverse);
+		// byte i = nibble 2i + 16 * nibble 2i + 1
+		__m128i pairs = _mm_maddubs_epi16(Nibbles128(c, valid), _mm_set1_epi16(0x1001));
+		uint64_t word;
+		_mm_storel_epi64(reinterpret_cast< __m128i * >(&word), _mm_packus_epi16(pairs, pairs));
+		return word;
+	}
+
+	template< typename Block >
+	LN_TARGET("ssse3")
+	bool ParseSsse3(const char *end, size_t words, Block *out)
+	{
+		__m128i valid = _mm_set1_epi8(-1);
+		for (size_t i = 0; i < words; ++i)
+		{
+			StoreWord(out, i, Word128(end - 16 * (i + 1), valid));
+		}
+		return _mm_movemask_epi8(valid) == 0xffff;
+	}
+
+	template< typename Block >
+	LN_TARGET("avx2")
+	bool ParseAvx2(const char *end, size_t words, Block *out)
+	{
+		// the same steps as Word128 on two words at once, one per lane
+		const __m256i reverse = _mm256_setr_epi8(
+			15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+			15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+		__m256i valid = _mm256_set1_epi8(-1);
+		size_t i = 0;
+		for (; i + 2 <= words; i += 2)
+		{
+			__m256i c = _mm256_loadu_si256(reinterpret_cast< const __m256i * >(end - 16 * (i + 2)));
+			c = _mm256_shuffle_epi8(c, reverse);
+			__m256i digit = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+			__m256i alpha = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+			__m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+			__m256i is_alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8(5)), alpha);
+			valid = _mm256_and_si256(valid, _mm256_or_si256(is_digit, is_alpha));
+			__m256i nibbles = _mm256_or_si256(
+				_mm256_and_si256(is_digit, digit),
+				_mm256_and_si256(is_alpha, _mm256_add_epi8(alpha, _mm256_set1_epi8(10))));
+			__m256i pairs = _mm256_maddubs_epi16(nibbles, _mm256_set1_epi16(0x1001));
+			__m256i packed = _mm256_packus_epi16(pairs, pairs);
+
+			// the low lane holds the more significant word
+			uint64_t high;
+			uint64_t low;
+			_mm_storel_epi64(reinterpret_cast< __m128i * >(&high), _mm256_castsi256_si128(packed));
+			_mm_storel_epi64(reinterpret_cast< __m128i * >(&low), _mm256_extracti128_si256(packed, 1));
+			StoreWord(out, i, low);
+			StoreWord(out, i + 1, high);
+		}
+		__m128i tail_valid = _mm_set1_epi8(-1);
+		if (i < words)
+		{
+			StoreWord(out, i, Word128(end - 16 * (i + 1), tail_valid));
+		}
+		return _mm256_movemask_epi8(valid) == -1 && _mm_movemask_epi8(tail_valid) == 0xffff;
+	}
+
+	struct CpuFeatures
+	{
+		bool ssse3 = false;
+		bool avx2 = false;
+	};
+
+	CpuFeatures DetectCpuOnce()
+	{
+		CpuFeatures features;
+		unsigned int regs1[4] = {};
+		unsigned int regs7[4] = {};
+#	if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		int max_leaf = info[0];
+		__cpuid(info, 1);
+		std::copy(info, info + 4, regs1);
+		if (max_leaf >= 7)
+		{
+			__cpuidex(info, 7, 0);
+			std::copy(info, info + 4, regs7);
+		}
+		auto xcr0 = [] { return static_cast< unsigned long long >(_xgetbv(0)); };
+#	else
+		unsigned int max_leaf = __get_cpuid_max(0, nullptr);
+		__get_cpuid(1, &regs1[0], &regs1[1], &regs1[2], &regs1[3]);
+		if (max_leaf >= 7)
+		{
+			__cpuid_count(7, 0, regs7[0], regs7[1], regs7[2], regs7[3]);
+		}
+		auto xcr0 = []
+		{
+			unsigned int lo;
+			unsigned int hi;
+			__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+			return static_cast< unsigned long long >(hi) << 32 | lo;
+		};
+#	endif
+		features.ssse3 = (regs1[2] >> 9) & 1;
+		// AVX2 also needs the OS to save the ymm registers
+		bool osxsave = (regs1[2] >> 27) & 1;
+		bool ymm_saved = osxsave && (xcr0() & 6) == 6;
+		features.avx2 = ymm_saved && ((regs7[1] >> 5) & 1);
+		return features;
+	}
+
+	const CpuFeatures &DetectCpu()
+	{
+		static const CpuFeatures features = DetectCpuOnce();
+		return features;
+	}
+#endif
+
+	// all digits of blocks[0, count), blocks[count - 1] first
+	template< typename Block >
+	void FormatScalar(const Block *blocks, size_t count, char *out)
+	{
+		for (size_t i = count; i-- > 0;)
+		{
+			for (size_t shift = sizeof(Block) * 8; shift > 0; shift -= 4)
+			{
+				*out++ = digit_chars[(blocks[i] >> (shift - 4)) & 0xf];
+			}
+		}
+	}
+
+#ifdef LN_HEX_X86
+	// 8 bytes at a time: reverse them, split every byte into its two nibbles
+	// and look the nibbles up in a 16-byte table with one shuffle
+	template< typename Block >
+	LN_TARGET("ssse3")
+	void FormatSsse3(const Block *blocks, size_t count, char *out)
+	{
+		const unsigned char *bytes = reinterpret_cast< const unsigned char * >(blocks);
+		size_t n = count * sizeof(Block);
+		const __m128i digits = _mm_loadu_si128(reinterpret_cast< const __m128i * >(digit_chars));
+		const __m128i reverse = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, -1, -1, -1, -1, -1, -1, -1, -1);
+		const __m128i low_nibbles = _mm_set1_epi8(0xf);
+		for (; n >= 8; n -= 8, out += 16)
+		{
+			__m128i x = _mm_shuffle_epi8(_mm_loadl_epi64(reinterpret_cast< const __m128i * >(bytes + n - 8)), reverse);
+			__m128i high = _mm_and_si128(_mm_srli_epi16(x, 4), low_nibbles);
+			__m128i low = _mm_and_si128(x, low_nibbles);
+			__m128i nibbles = _mm_unpacklo_epi8(high, low);
+			_mm_storeu_si128(reinterpret_cast< __m128i * >(out), _mm_shuffle_epi8(digits, nibbles));
+		}
+		// a single 32-bit block may be left at the bottom
+		FormatScalar(blocks, n / sizeof(Block), out);
+	}
+#endif
+
+	template< typename Block >
+	using FormatFn = void (*)(const Block *, size_t, char *);
+
+	template< typename Block >
+	FormatFn< Block > FormatKernel()
+	{
+		static const FormatFn< Block > kernel = []() -> FormatFn< Block >
+		{
+#ifdef LN_HEX_X86
+			if (DetectCpu().ssse3)
+			{
+				return FormatSsse3< Block >;
+			}
+#endif
+			return FormatScalar< Block >;
+		}();
+		return kernel;
+	}
+
+	// the digits of the top block without leading zeros
+	template< typename Block >
+	char *FormatTop(Block top, char *out)
+	{
+		for (size_t shift = (std::bit_width(top) + 3) / 4 * 4; shift > 0; shift -= 4)
+		{
+			*out++ = digit_chars[(top >> (shift - 4)) & 0xf];
+		}
+		return out;
+	}
+}	 // namespace
+
+void LN::FromStringLike(const char *begin, const char *end)
+{
+	if (begin == end)
+	{
+		is_nan_ = true;
+		return;
+	}
+
+	using Kernel = bool (*)(const char *, size_t, Block *);
+	// picked once, function-local statics are initialized thread-safely
+	static const Kernel kernel = []() -> Kernel
+	{
+#ifdef LN_HEX_X86
+		const CpuFeatures &cpu = DetectCpu();
+		if (cpu.avx2)
+		{
+			return ParseAvx2< Block >;
+		}
+		else if (cpu.ssse3)
+		{
+			return ParseSsse3< Block >;
+		}
+#endif
+		return ParseScalar< Block >;
+	}();
+
+	constexpr size_t blocks_in_word = 64 / bits_in_block_;
+	size_t digits = end - begin;
+	size_t words = digits / 16;
+	size_t head = digits % 16;
+	data_.resize_uninitialized((words + (head != 0)) * blocks_in_word);
+
+	uint8_t bad = 0;
+	bool valid = kernel(end, words, data_.get_data());
+	if (head != 0)
+	{
+		StoreWord(data_.get_data(), words, ParseShort(begin, begin + head, bad));
+	}
+	if (!valid || (bad & 0x80) != 0)
+	{
+		data_.resize(0);
+		is_nan_ = true;
+		return;
+	}
+	Normalize();
+}
+
+size_t LN::StringLength() const
+{
+	if (is_nan_)
+	{
+		return 3;
+	}
+	else if (data_.get_size() == 0)
+	{
+		return 1;
+	}
+	return (BitLength() + bits_in_digit_ - 1) / bits_in_digit_ + (sign_ == -1);
+}
+
+char *LN::WriteTo(char *out) const
+{
+	if (is_nan_)
+	{
+		return std::copy_n("NaN", 3, out);
+	}
+	size_t n = data_.get_size();
+	if (n == 0)
+	{
+		*out = '0';
+		return out + 1;
+	}
+	if (sign_ == -1)
+	{
+		*out++ = '-';
+	}
+	out = FormatTop(data_[n - 1], out);
+	FormatKernel< Block >()(data_.get_data(), n - 1, out);
+	return out + (n - 1) * digits_in_block_;
+}
+
+void LN::WriteTo(std::ostream &out) const
+{
+	size_t n = data_.get_size();
+	if (is_nan_ || n == 0)
+	{
+		char small[3];
+		out.write(small, WriteTo(small) - small);
+		return;
+	}
+
+	// through a fixed buffer, long numbers never exist as one string
+	constexpr size_t buffer_blocks = 4096 / digits_in_block_;
+	char buffer[buffer_blocks * digits_in_block_];
+	char *p = buffer;
+	if (sign_ == -1)
+	{
+		*p++ = '-';
+	}
+	p = FormatTop(data_[n - 1], p);
+	out.write(buffer, p - buffer);
+	for (size_t end = n - 1; end > 0;)
+	{
+		size_t count = std::min(end, buffer_blocks);
+		end -= count;
+		FormatKernel< Block >()(data_.get_data() + end, count, buffer);
+		out.write(buffer, static_cast< std::streamsize >(count * digits_in_block_));
+	}
+}
@@ -0,0 +1,230 @@
+#include "InputReader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+namespace
+{
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || (c >= '\t' && c <= '\r');
+	}
+}	 // namespace
+
+InputReader::InputReader(const char *path)
+{
+	if (Map(path))
+	{
+		open_ = true;
+		return;
+	}
+	stream_.open(path, std::ios::binary);
+	open_ = !stream_.fail();
+}
+
+InputReader::~InputReader()
+{
+	Unmap();
+}
+
+bool InputReader::IsOpen() const
+{
+	return open_;
+}
+
+#ifdef _WIN32
+bool InputReader::Map(const char *path)
+{
+	HANDLE file = CreateFileA(path,
+							  GENERIC_READ,
+							  FILE_SHARE_READ,
+							  nullptr,
+							  OPEN_EXISTING,
+							  FILE_FLAG_SEQUENTIAL_SCAN,
+							  nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size) || size.QuadPart == 0 ||
+		static_cast< unsigned long long >(size.QuadPart) > SIZE_MAX)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void *view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (view == nullptr)
+	{
+		if (mapping != nullptr)
+		{
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		return false;
+	}
+	file_handle_ = file;
+	mapping_handle_ = mapping;
+	map_ = view;
+	map_size_ = static_cast< size_t >(size.QuadPart);
+	pos_ = static_cast< const char * >(map_);
+	end_ = pos_ + map_size_;
+	return true;
+}
+
+void InputReader::Unmap()
+{
+	if (map_ != nullptr)
+	{
+		UnmapViewOfFile(map_);
+		CloseHandle(mapping_handle_);
+		CloseHandle(file_handle_);
+		map_ = nullptr;
+	}
+}
+#else
+bool InputReader::Map(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+		static_cast< unsigned long long >(st.st_size) > SIZE_MAX)
+	{
+		close(fd);
+		return false;
+	}
+	size_t size = static_cast< size_t >(st.st_size);
+	void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps the file referenced on its own
+	close(fd);
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+	madvise(view, size, MADV_SEQUENTIAL);
+	map_ = view;
+	map_size_ = size;
+	pos_ = static_cast< const char * >(map_);
+	end_ = pos_ + map_size_;
+	return true;
+}
+
+void InputReader::Unmap()
+{
+	if (map_ != nullptr)
+	{
+		munmap(map_, map_size_);
+		map_ = nullptr;
+	}
+}
+#endif
+
+bool InputReader::Refill(const char *&start)
+{
+	if (map_ != nullptr || eof_)
+	{
+		return false;
+	}
+	size_t kept = end_ - start;
+	if (kept == buffer_.size())
+	{
+		// the pending token fills the whole buffer
+		std::vector< char > bigger(std::max(chunk_size_, 2 * buffer_.size()));
+		std::copy(start, end_, bigger.data());
+		buffer_.swap(bigger);
+	}
+	else if (kept != 0)
+	{
+		std::memmove(buffer_.data(), start, kept);
+	}
+	stream_.read(buffer_.data() + kept, static_cast< std::streamsize >(buffer_.size() - kept));
+	size_t got = static_cast< size_t >(stream_.gcount());
+	eof_ = got == 0;
+	start = buffer_.data();
+	end_ = start + kept + got;
+	return got != 0;
+}
+
+bool InputReader::Next(std::string_view &token)
+{
+	const char *start = pos_;
+	while (true)
+	{
+		while (start < end_ && IsSpace(*start))
+		{
+			++start;
+		}
+		if (start < end_)
+		{
+			break;
+		}
+		start = end_;
+		if (!Refill(start))
+		{
+			pos_ = end_;
+			return false;
+		}
+	}
+
+	const char *p = start;
+	while (true)
+	{
+		while (p < end_ && !IsSpace(*p))
+		{
+			++p;
+		}
+		if (p < end_)
+		{
+			break;
+		}
+		// the token may go on in the next chunk, the scan resumes where it stopped
+		size_t scanned = p - start;
+		if (!Refill(start))
+		{
+			break;
+		}
+		p = start + scanned;
+	}
+	token = std::string_view(start, p - start);
+	pos_ = p;
+	return true;
+}
+
+std::string_view InputReader::Contents()
+{
+	if (map_ != nullptr)
+	{
+		return { static_cast< const char * >(map_), map_size_ };
+	}
+	size_t size = 0;
+	while (!eof_)
+	{
+		if (buffer_.size() - size < chunk_size_)
+		{
+			buffer_.resize(std::max(size + chunk_size_, 2 * buffer_.size()));
+		}
+		stream_.read(buffer_.data() + size, static_cast< std::streamsize >(buffer_.size() - size));
+		size_t got = static_cast< size_t >(stream_.gcount());
+		eof_ = got == 0;
+		size += got;
+	}
+	pos_ = end_ = buffer_.data() + size;
+	return { buffer_.data(), size };
+}
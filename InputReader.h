@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+// Whitespace-separated tokens of a file. Regular files are memory-mapped and
+// the tokens point straight into the mapping; anything that cannot be mapped
+// (pipes, devices) is read in chunks instead.
+class InputReader
+{
+  public:
+	explicit InputReader(const char *path);
+	~InputReader();
+
+	InputReader(const InputReader &) = delete;
+	InputReader &operator=(const InputReader &) = delete;
+
+	// false if the file could not be opened
+	bool IsOpen() const;
+
+	// the next token, valid until the following call; false at the end
+	bool Next(std::string_view &token);
+	// the whole file, for binary input instead of Next; points into the
+	// mapping if there is one and is read into memory otherwise
+	std::string_view Contents();
+
+  private:
+	static constexpr size_t chunk_size_ = size_t(1) << 20;
+
+	const char *pos_ = nullptr;
+	const char *end_ = nullptr;
+	bool open_ = false;
+
+	// set while the file is mapped
+	void *map_ = nullptr;
+	size_t map_size_ = 0;
+#ifdef _WIN32
+	void *file_handle_ = nullptr;
+	void *mapping_handle_ = nullptr;
+#endif
+
+	// the chunked fallback
+	std::ifstream stream_;
+	std::vector< char > buffer_;
+	bool eof_ = false;
+
+	bool Map(const char *path);
+	void Unmap();
+	// moves [start, end_) to the front of the buffer and reads after it,
+	// start is updated; false when nothing more could be read
+	bool Refill(const char *&start);
+};
@@ -1,76 +1,93 @@
 #include "LN.h"
+#include "LNExpr.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
 
-const char HEX_DIGITS[] = "0123456789ABCDEF";
 const LN LN::LONG_LONG_MAX_ = { std::numeric_limits< long long >::max() };
 const LN LN::LONG_LONG_MIN_ = { std::numeric_limits< long long >::min() };
 const LN LN::NaN_ = LN::GetNaN();
 
-using std::uint32_t;
-int nlz1(uint32_t x)
+// measured with --calibrate (see Calibrate.cpp) on x86-64
+#ifdef LN_64BIT_BLOCKS
+LN::Tuning LN::tuning = {
+	.karatsuba_threshold = 24,
+	.toom3_threshold = 256,
+	.toom4_threshold = 448,
+	.ntt_threshold = 12000,
+	.karatsuba_sqr_threshold = 48,
+	.toom3_sqr_threshold = 320,
+	.toom4_sqr_threshold = 640,
+	.ntt_sqr_threshold = 12000,
+	.burnikel_ziegler_threshold = 112,
+	.parallel_threshold = 1024,
+};
+#else
+LN::Tuning LN::tuning = {
+	.karatsuba_threshold = 27,
+	.toom3_threshold = 224,
+	.toom4_threshold = 896,
+	.ntt_threshold = 4096,
+	.karatsuba_sqr_threshold = 54,
+	.toom3_sqr_threshold = 288,
+	.toom4_sqr_threshold = 1152,
+	.ntt_sqr_threshold = 4096,
+	.burnikel_ziegler_threshold = 96,
+	.parallel_threshold = 2048,
+};
+#endif
+
+ThreadPool *LN::threads = nullptr;
+
+#if defined(LN_64BIT_BLOCKS) && (defined(__x86_64__) || defined(_M_X64))
+#	include <immintrin.h>
+#	define LN_USE_ADC_INTRINSICS 1
+#endif
+
+inline LN::Block LN::AddCarry(Block a, Block b, unsigned char &carry)
 {
-	int n;
-	if (x == 0)
-		return (32);
-	n = 0;
-	if (x <= 0x0000FFFF)
-	{
-		n = n + 16;
-		x = x << 16;
-	}
-	if (x <= 0x00FFFFFF)
-	{
-		n = n + 8;
-		x = x << 8;
-	}
-	if (x <= 0x0FFFFFFF)
-	{
-		n = n + 4;
-		x = x << 4;
-	}
-	if (x <= 0x3FFFFFFF)
-	{
-		n = n + 2;
-		x = x << 2;
-	}
-	if (x <= 0x7FFFFFFF)
-	{
-		n = n + 1;
-	}
-	return n;
+#ifdef LN_USE_ADC_INTRINSICS
+	unsigned long long res;
+	carry = _addcarry_u64(carry, a, b, &res);
+	return res;
+#else
+	DoubleBlock sum = static_cast< DoubleBlock >(a) + b + carry;
+	carry = static_cast< unsigned char >(sum >> bits_in_block_);
+	return static_cast< Block >(sum);
+#endif
+}
+
+inline LN::Block LN::SubBorrow(Block a, Block b, unsigned char &borrow)
+{
+#ifdef LN_USE_ADC_INTRINSICS
+	unsigned long long res;
+	borrow = _subborrow_u64(borrow, a, b, &res);
+	return res;
+#else
+	Block diff = a - b - borrow;
+	borrow = (a < b || (a == b && borrow)) ? 1 : 0;
+	return diff;
+#endif
 }
 
 LN::LN(long long n)
 {
 	is_nan_ = false;
-	bool min_value = false;
-	if (n == std::numeric_limits< long long >::min())
-	{
-		n += 1;
-		min_value = true;
-	}
+	sign_ = n < 0 ? -1 : 1;
+	// negation in unsigned arithmetic is well defined for LLONG_MIN as well
+	unsigned long long abs_n = n < 0 ? 0ULL - static_cast< unsigned long long >(n) : n;
 
-	if (n < 0)
-	{
-		sign_ = -1;
-		n = -n;
-	}
-	else
-	{
-		sign_ = 1;
-	}
-
-	constexpr Block all_ones = std::numeric_limits< Block >::max();
-	size_t bits_in_block = sizeof(Block) * 8;
-
-	while (n > 0)
-	{
-		data_.push_back(static_cast< Block >(n & all_ones));
-		n >>= bits_in_block;
-	}
-
-	if (min_value)
+	size_t blocks = (std::bit_width(abs_n) + bits_in_block_ - 1) / bits_in_block_;
+	data_.resize_uninitialized(blocks);
+	for (size_t i = 0; i < blocks; ++i)
 	{
-		*this -= 1LL;
+		data_[i] = static_cast< Block >(abs_n);
+		if constexpr (bits_in_block_ < sizeof(abs_n) * 8)
+		{
+			abs_n >>= bits_in_block_;
+		}
 	}
 }
 
@@ -101,18 +118,17 @@ LN::LN(std::string_view sv)
 	{
 		return;
 	}
-	auto it = std::begin(sv);
-
-	if (*it == '-')
+	const char *begin = sv.data();
+	if (*begin == '-')
 	{
 		sign_ = -1;
-		++it;
+		++begin;
 	}
 
-	FromStringLike(it, std::end(sv));
+	FromStringLike(begin, sv.data() + sv.size());
 }
 
-LN LN::operator+(const LN &other) const
+LN LN::operator+(const LN &other) const &
 {
 	if (is_nan_ || other.is_nan_)
 	{
@@ -146,13 +162,48 @@ LN LN::operator+(const LN &other) const
 	}
 }
 
+LN LN::operator+(const LN &other) &&
+{
+	*this += other;
+	return std::move(*this);
+}
+
+LN LN::operator+(LN &&other) const &
+{
+	other += *this;
+	return std::move(other);
+}
+
+LN LN::operator+(LN &&other) &&
+{
+	// the longer one is less likely to have to grow
+	if (other.data_.get_size() > data_.get_size())
+	{
+		other += *this;
+		return std::move(other);
+	}
+	*this += other;
+	return std::move(*this);
+}
+
 LN &LN::operator+=(const LN &other)
 {
-	*this = *this + other;
+	if (is_nan_ || other.is_nan_)
+	{
+		*this = NaN_;
+	}
+	else if (sign_ == other.sign_)
+	{
+		AddAbs(other);
+	}
+	else
+	{
+		SubAbs(other);
+	}
 	return *this;
 }
 
-LN LN::operator-(const LN &other) const
+LN LN::operator-(const LN &other) const &
 {
 	if (is_nan_ || other.is_nan_)
 	{
@@ -186,9 +237,47 @@ LN LN::operator-(const LN &other) const
 	}
 }
 
+LN LN::operator-(const LN &other) &&
+{
+	*this -= other;
+	return std::move(*this);
+}
+
+LN LN::operator-(LN &&other) const &
+{
+	// x - y = -(y - x), a zero difference keeps its positive sign
+	other -= *this;
+	if (other.data_.get_size() != 0)
+	{
+		other.sign_ = -other.sign_;
+	}
+	return std::move(other);
+}
+
+LN LN::operator-(LN &&other) &&
+{
+	if (other.data_.get_size() > data_.get_size())
+	{
+		return *this - std::move(other);
+	}
+	*this -= other;
+	return std::move(*this);
+}
+
 LN &LN::operator-=(const LN &other)
 {
-	*this = *this - other;
+	if (is_nan_ || other.is_nan_)
+	{
+		*this = NaN_;
+	}
+	else if (sign_ != other.sign_)
+	{
+		AddAbs(other);
+	}
+	else
+	{
+		SubAbs(other);
+	}
 	return *this;
 }
 
@@ -200,7 +289,7 @@ LN LN::operator*(const LN &other) const
 	}
 	else
 	{
-		LN result = KaraMul(*this, other);
+		LN result = Mul(*this, other);
 		result.sign_ = sign_ * other.sign_;
 		return result;
 	}
@@ -216,7 +305,7 @@ LN LN::operator/(const LN &other) const
 {
 	LN quotitent;
 	int new_sign = sign_ * other.sign_;
-	divmnu(&quotitent, nullptr, *this, other);
+	Div(&quotitent, nullptr, *this, other);
 	quotitent.sign_ = new_sign;
 	return quotitent;
 }
@@ -224,7 +313,7 @@ LN LN::operator/(const LN &other) const
 LN &LN::operator/=(const LN &other)
 {
 	int new_sign = sign_ * other.sign_;
-	divmnu(this, nullptr, *this, other);
+	Div(this, nullptr, *this, other);
 	sign_ = new_sign;
 	return *this;
 }
@@ -232,9 +321,8 @@ LN &LN::operator/=(const LN &other)
 LN LN::operator%(const LN &other) const
 {
 	int new_sign = sign_ * other.sign_;
-	LN quotitent;
 	LN remainder;
-	divmnu(&quotitent, &remainder, *this, other);
+	Div(nullptr, &remainder, *this, other);
 	remainder.sign_ = new_sign;
 	return remainder;
 }
@@ -242,49 +330,79 @@ LN LN::operator%(const LN &other) const
 LN &LN::operator%=(const LN &other)
 {
 	int new_sign = sign_ * other.sign_;
-	LN quotitent;
-	divmnu(&quotitent, this, *this, other);
+	Div(nullptr, this, *this, other);
 	sign_ = new_sign;
 	return *this;
 }
 
-LN LN::operator-() const
+std::pair< LN, LN > LN::DivMod(const LN &num, const LN &den)
 {
-	LN result = *this;
-	result.sign_ = -sign_;
+	std::pair< LN, LN > result;
+	DivMod(num, den, result.first, result.second);
 	return result;
 }
 
-LN LN::operator~() const
+void LN::DivMod(const LN &num, const LN &den, LN &quotient, LN &remainder)
 {
-	size_t n = data_.get_size();
-	if (sign_ == -1)
+	int new_sign = num.sign_ * den.sign_;
+	bool nan = num.is_nan_ || den.is_nan_;
+	quotient.is_nan_ = false;
+	remainder.is_nan_ = false;
+	if (nan)
 	{
-		return NaN_;
+		quotient = NaN_;
+		remainder = NaN_;
+		return;
 	}
-	else if (n == 0)
+	Div(&quotient, &remainder, num, den);
+	quotient.sign_ = new_sign;
+	remainder.sign_ = new_sign;
+}
+
+LN LN::Square() const
+{
+	if (is_nan_)
 	{
-		return LN{ 0LL };
+		return NaN_;
 	}
-	LN x;
-	static const LN LN1{ 1LL };
-	static const LN LN0{ 0LL };
-	size_t init_size = (n + 1) / 2 + 1;
-	x.data_ = MyDumbVector< Block >(init_size);
-	x.data_[init_size - 1] = 1;	   // std::numeric_limits<Block>::max() / 2;
-	while (true)
-	{
-		LN next = x;
-		next += *this / next;
-		next.Div2();
+	return Sqr(*this);
+}
 
-		LN diff = next - x;
-		if (diff == LN1 || diff == LN0)
+LN LN::operator-() const &
+{
+	LN result = *this;
+	result.sign_ = -sign_;
+	return result;
+}
+
+LN LN::operator-() &&
+{
+	sign_ = -sign_;
+	return std::move(*this);
+}
+
+LN LN::operator~() const
+{
+	return Sqrt();
+}
+
+LN LN::Sqrt(LN *remainder) const
+{
+	if (is_nan_ || (sign_ == -1 && data_.get_size() != 0))
+	{
+		if (remainder != nullptr)
 		{
-			return x;
+			*remainder = NaN_;
 		}
-		x = next;
+		return NaN_;
 	}
+	LN rem;
+	LN root = SqrtRem(*this, rem);
+	if (remainder != nullptr)
+	{
+		*remainder = std::move(rem);
+	}
+	return root;
 }
 
 std::partial_ordering LN::operator<=>(const LN &other) const
@@ -363,14 +481,17 @@ LN::operator long long() const
 	}
 	else
 	{
-		long long result = 0;
+		unsigned long long result = 0;
 		size_t blocks = data_.get_size();
 		for (size_t i = blocks; i != 0; --i)
 		{
-			result <<= sizeof(Block) * 8;
-			result |= static_cast< long long >(data_[i - 1]);
+			if constexpr (bits_in_block_ < sizeof(result) * 8)
+			{
+				result <<= bits_in_block_;
+			}
+			result |= static_cast< unsigned long long >(data_[i - 1]);
 		}
-		return result * sign_;
+		return static_cast< long long >(result) * sign_;
 	}
 }
 
@@ -381,37 +502,9 @@ LN::operator bool() const
 
 std::string LN::ToString() const
 {
-	if (is_nan_)
-	{
-		return "NaN";
-	}
-	else if (*this == LN{ 0LL } || data_.get_size() == 0)
-	{
-		return "0";
-	}
-	else
-	{
-		std::string result;
-		size_t blocks = data_.get_size();
-		for (size_t i = 0; i < blocks; ++i)
-		{
-			Block b = data_[i];
-			for (int j = 0; j < sizeof(Block) * 8; j += 4)
-			{
-				result.push_back(HEX_DIGITS[(b >> j) & 0xf]);
-			}
-		}
-		while (result.back() == '0')
-		{
-			result.pop_back();
-		}
-		if (sign_ == -1)
-		{
-			result.push_back('-');
-		}
-		std::reverse(std::begin(result), std::end(result));
-		return result;
-	}
+	std::string result(StringLength(), '\0');
+	WriteTo(result.data());
+	return result;
 }
 
 bool LN::IsNaN() const
@@ -429,7 +522,7 @@ LN LN::GetNaN()
 std::strong_ordering LN::abs_compare(const LN &other) const
 {
 	std::strong_ordering abs_order = data_.get_size() <=> other.data_.get_size();
-	if (abs_order == std::strong_ordering::equivalent)
+	if (abs_order == std::strong_ordering::equivalent && data_.get_size() != 0)
 	{
 		size_t i = data_.get_size();
 		do
@@ -446,185 +539,1064 @@ LN::Block LN::get_block(size_t i) const
 	return i >= data_.get_size() ? 0 : data_[i];
 }
 
-void LN::Div2()
+void LN::Normalize()
 {
 	size_t n = data_.get_size();
-	for (size_t i = 0; i < n; ++i)
+	while (n != 0 && data_[n - 1] == 0)
 	{
-		data_[i] = (data_[i] >> 1) | (get_block(i + 1) & 1);
+		--n;
 	}
-	if (data_[n - 1] == 0)
+	data_.resize(n);
+}
+
+size_t LN::BitLength() const
+{
+	size_t n = data_.get_size();
+	return n == 0 ? 0 : n * bits_in_block_ - std::countl_zero(data_[n - 1]);
+}
+
+LN::Block LN::AddBlocks(Block *r, const Block *a, size_t an, const Block *b, size_t bn)
+{
+	unsigned char carry = 0;
+	size_t i = 0;
+	for (; i < bn; ++i)
 	{
-		data_.pop();
+		r[i] = AddCarry(a[i], b[i], carry);
 	}
+	for (; i < an && carry; ++i)
+	{
+		r[i] = AddCarry(a[i], 0, carry);
+	}
+	if (r != a)
+	{
+		std::copy(a + i, a + an, r + i);
+	}
+	return carry;
 }
 
-LN LN::SaneAdd(const LN &left, const LN &right)
+LN::Block LN::SubBlocks(Block *r, const Block *a, size_t an, const Block *b, size_t bn)
 {
-	LN result;
+	unsigned char borrow = 0;
+	size_t i = 0;
+	for (; i < bn; ++i)
+	{
+		r[i] = SubBorrow(a[i], b[i], borrow);
+	}
+	for (; i < an && borrow; ++i)
+	{
+		r[i] = SubBorrow(a[i], 0, borrow);
+	}
+	if (r != a)
+	{
+		std::copy(a + i, a + an, r + i);
+	}
+	return borrow;
+}
 
-	size_t i;
-	size_t ls = left.data_.get_size();
-	size_t rs = right.data_.get_size();
+void LN::AddAbs(const LN &other)
+{
+	size_t ls = data_.get_size();
+	size_t rs = other.data_.get_size();
+	size_t n = std::max(ls, rs);
+
+	// other may be *this, so its blocks are only read after the resize
+	data_.resize(n + 1);
+	Block *res = data_.get_data();
+	data_[n] = AddBlocks(res, res, n, other.data_.get_data(), rs);
+	if (data_[n] == 0)
+	{
+		data_.resize(n);
+	}
+}
 
-	Block carry = 0;
+void LN::SubAbs(const LN &other)
+{
+	auto order = abs_compare(other);
+	if (order == std::strong_ordering::equivalent)
+	{
+		data_.resize(0);
+		sign_ = 1;
+		return;
+	}
 
-	for (i = 0; i < ls || i < rs || carry; ++i)
+	size_t ls = data_.get_size();
+	size_t rs = other.data_.get_size();
+	if (order == std::strong_ordering::greater)
 	{
-		Block new_block;
+		Block *res = data_.get_data();
+		SubBlocks(res, res, ls, other.data_.get_data(), rs);
+	}
+	else
+	{
+		// only the first ls blocks of res are read
+		data_.resize_uninitialized(rs);
+		Block *res = data_.get_data();
+		SubBlocks(res, other.data_.get_data(), rs, res, ls);
+		sign_ = -sign_;
+	}
+	Normalize();
+}
 
-		uint64_t el = left.get_block(i);
-		uint64_t er = right.get_block(i);
-		uint64_t ex = el + er;
+LN LN::SaneAdd(const LN &left, const LN &right)
+{
+	const LN &longer = left.data_.get_size() >= right.data_.get_size() ? left : right;
+	const LN &shorter = &longer == &left ? right : left;
+	size_t n = longer.data_.get_size();
 
-		ex += carry;
-		carry = 0;
-		new_block = static_cast< Block >(ex & std::numeric_limits< Block >::max());
-		carry = static_cast< Block >(ex >> sizeof(Block) * 8);
-		result.data_.push_back(new_block);
+	LN result;
+	result.data_.resize_uninitialized(n + 1);
+	Block *res = result.data_.get_data();
+	res[n] = AddBlocks(res, longer.data_.get_data(), n, shorter.data_.get_data(), shorter.data_.get_size());
+	if (res[n] == 0)
+	{
+		result.data_.resize(n);
 	}
-
 	return result;
 }
 
 // left > right
 LN LN::SaneSub(const LN &left, const LN &right)
 {
+	size_t n = left.data_.get_size();
+
 	LN result;
+	result.data_.resize_uninitialized(n);
+	SubBlocks(result.data_.get_data(), left.data_.get_data(), n, right.data_.get_data(), right.data_.get_size());
+	result.Normalize();
+	return result;
+}
 
-	size_t i;
-	size_t ls = left.data_.get_size();
-	size_t rs = right.data_.get_size();
+void LN::ShiftLeft(size_t bits)
+{
+	size_t n = data_.get_size();
+	if (n == 0)
+	{
+		return;
+	}
+	size_t blocks = bits / bits_in_block_;
+	size_t s = bits % bits_in_block_;
 
-	Block carry = 0;
+	data_.resize_uninitialized(n + blocks + 1);
+	Block *d = data_.get_data();
+	d[n + blocks] = s ? d[n - 1] >> (bits_in_block_ - s) : 0;
+	for (size_t i = n - 1; i > 0; --i)
+	{
+		d[i + blocks] = (d[i] << s) | (s ? d[i - 1] >> (bits_in_block_ - s) : 0);
+	}
+	d[blocks] = d[0] << s;
+	std::fill(d, d + blocks, 0);
+	Normalize();
+}
 
-	for (i = 0; i < ls || i < rs || carry; ++i)
+void LN::ShiftRight(size_t bits)
+{
+	size_t n = data_.get_size();
+	size_t blocks = bits / bits_in_block_;
+	size_t s = bits % bits_in_block_;
+	if (blocks >= n)
+	{
+		data_.resize(0);
+		return;
+	}
+
+	size_t m = n - blocks;
+	Block *d = data_.get_data();
+	for (size_t i = 0; i + 1 < m; ++i)
 	{
-		Block new_block;
+		d[i] = (d[i + blocks] >> s) | (s ? d[i + blocks + 1] << (bits_in_block_ - s) : 0);
+	}
+	d[m - 1] = d[n - 1] >> s;
+	data_.resize(m);
+	Normalize();
+}
 
-		uint64_t el = left.get_block(i);
-		uint64_t er = right.get_block(i);
+void LN::DivExact(Block d)
+{
+	// inverse of d modulo 2^bits_in_block_, every Newton step doubles the
+	// number of correct low bits starting from 3
+	Block inv = d;
+	for (int i = 0; i < 5; ++i)
+	{
+		inv *= 2 - d * inv;
+	}
 
-		er += carry;
-		carry = 0;
+	Block *data = data_.get_data();
+	Block borrow = 0;
+	for (size_t i = 0; i < data_.get_size(); ++i)
+	{
+		Block c = data[i] < borrow;
+		Block q = (data[i] - borrow) * inv;
+		data[i] = q;
+		borrow = static_cast< Block >(static_cast< DoubleBlock >(q) * d >> bits_in_block_) + c;
+	}
+	Normalize();
+}
 
-		if (er > el)
+void LN::AddShifted(const LN &src, size_t blocks)
+{
+	size_t ss = src.data_.get_size();
+	if (ss == 0)
+	{
+		return;
+	}
+	size_t top = std::max(data_.get_size(), ss + blocks);
+	data_.resize(top + 1);
+	Block *res = data_.get_data() + blocks;
+	data_[top] = AddBlocks(res, res, top - blocks, src.data_.get_data(), ss);
+	Normalize();
+}
+
+LN LN::Slice(size_t from, size_t count) const
+{
+	LN result;
+	size_t n = data_.get_size();
+	if (from < n)
+	{
+		count = std::min(count, n - from);
+		result.data_.resize_uninitialized(count);
+		std::copy(data_.get_data() + from, data_.get_data() + from + count, result.data_.get_data());
+		result.Normalize();
+	}
+	return result;
+}
+
+LN::Block LN::AddMulBlock(Block *r, const Block *a, size_t n, Block b)
+{
+	Block carry = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		DoubleBlock t = static_cast< DoubleBlock >(a[i]) * b + r[i] + carry;
+		r[i] = static_cast< Block >(t);
+		carry = static_cast< Block >(t >> bits_in_block_);
+	}
+	return carry;
+}
+
+LN LN::SingleMul(const LN &num1, Block num2)
+{
+	LN result;
+	size_t n = num1.data_.get_size();
+	result.data_.resize_uninitialized(n + 1);
+	Block *res = result.data_.get_data();
+	std::fill(res, res + n, 0);
+	res[n] = AddMulBlock(res, num1.data_.get_data(), n, num2);
+	result.Normalize();
+	return result;
+}
+
+bool LN::Forks(size_t blocks)
+{
+	// the thread that allocated a limb buffer may not be the one freeing it
+	return threads != nullptr && threads->Threads() > 1 && blocks >= tuning.parallel_threshold &&
+		   dumb_vector_resource()->is_equal(*std::pmr::new_delete_resource());
+}
+
+void LN::Fork(size_t blocks, size_t count, const std::function< void(size_t) > &task)
+{
+	if (count < 2 || !Forks(blocks))
+	{
+		for (size_t i = 0; i < count; ++i)
 		{
-			el |= static_cast< uint64_t >(1) << (sizeof(Block) * 8);
-			carry = 1;
+			task(i);
 		}
+		return;
+	}
+
+	std::atomic< size_t > left{ count - 1 };
+	std::mutex error_mutex;
+	std::exception_ptr error;
+	auto run = [&](size_t i)
+	{
+		try
+		{
+			task(i);
+		} catch (...)
+		{
+			std::lock_guard< std::mutex > lock(error_mutex);
+			if (!error)
+			{
+				error = std::current_exception();
+			}
+		}
+	};
+	for (size_t i = 1; i < count; ++i)
+	{
+		threads->Submit(
+			[&run, &left, i]
+			{
+				run(i);
+				--left;
+			});
+	}
+	run(0);
+	// the others may still be queued, this thread helps with them
+	threads->WaitUntil([&left] { return left == 0; });
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
 
-		el -= er;
-		new_block = static_cast< Block >(el);
-		result.data_.push_back(new_block);
+LN LN::Mul(const LN &num1, const LN &num2)
+{
+	// equal operands square as well, as in "x x *"; telling them apart costs
+	// a pass only over the blocks they share from the bottom
+	size_t n = num1.data_.get_size();
+	if (&num1 == &num2 ||
+		(n == num2.data_.get_size() && n >= tuning.karatsuba_sqr_threshold &&
+		 std::equal(num1.data_.get_data(), num1.data_.get_data() + n, num2.data_.get_data())))
+	{
+		return Sqr(num1);
 	}
 
-	while (result.data_.get_size() != 0 && result.data_[result.data_.get_size() - 1] == 0)
+	const LN &longer = num1.data_.get_size() >= num2.data_.get_size() ? num1 : num2;
+	const LN &shorter = &longer == &num1 ? num2 : num1;
+	size_t n1 = longer.data_.get_size();
+	size_t n2 = shorter.data_.get_size();
+
+	if (n2 == 0)
+	{
+		return { 0LL };
+	}
+	else if (n2 == 1)
 	{
-		result.data_.pop();
+		return SingleMul(longer, shorter.data_[0]);
 	}
+	else if (n2 < tuning.toom3_threshold)
+	{
+		return KaraMul(longer, shorter);
+	}
+	else if (n2 >= tuning.ntt_threshold && NttFits(n1, n2))
+	{
+		return NttMul(longer, shorter);
+	}
+	else if (n1 >= 2 * n2)
+	{
+		// the Toom algorithms want balanced operands, so cut the longer one
+		// into pieces of the shorter one's size
+		size_t pieces = (n1 + n2 - 1) / n2;
+		std::vector< LN > products(pieces);
+		Fork(n2, pieces, [&](size_t i) { products[i] = Mul(longer.Slice(i * n2, n2), shorter); });
+		LN result;
+		for (size_t i = 0; i < pieces; ++i)
+		{
+			result.AddShifted(products[i], i * n2);
+		}
+		return result;
+	}
+	else if (n2 < tuning.toom4_threshold)
+	{
+		return Toom3Mul(longer, shorter);
+	}
+	else
+	{
+		return Toom4Mul(longer, shorter);
+	}
+}
 
+LN LN::KaraMul(const LN &num1, const LN &num2)
+{
+	size_t n1 = num1.data_.get_size();
+	size_t n2 = num2.data_.get_size();
+
+	LN result;
+	result.data_.resize_uninitialized(n1 + n2);
+	MyDumbVector< Block > scratch;
+	scratch.resize_uninitialized(KaraScratchSize(n1, tuning.karatsuba_threshold));
+	MulBlocks(result.data_.get_data(), num1.data_.get_data(), n1, num2.data_.get_data(), n2, scratch.get_data());
+	result.Normalize();
 	return result;
 }
 
-void LN::BlockShift(size_t blocks)
+size_t LN::KaraScratchSize(size_t n, size_t threshold)
+{
+	if (n < std::max< size_t >(threshold, 2))
+	{
+		return 0;
+	}
+	size_t m = (n + 1) / 2;
+	return 6 * m + 1 + KaraScratchSize(m, threshold);
+}
+
+int LN::CompareBlocks(const Block *a, size_t an, const Block *b, size_t bn)
+{
+	for (; an > bn; --an)
+	{
+		if (a[an - 1] != 0)
+		{
+			return 1;
+		}
+	}
+	for (; bn > an; --bn)
+	{
+		if (b[bn - 1] != 0)
+		{
+			return -1;
+		}
+	}
+	for (size_t i = an; i-- > 0;)
+	{
+		if (a[i] != b[i])
+		{
+			return a[i] < b[i] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+void LN::SchoolMulBlocks(Block *r, const Block *a, size_t an, const Block *b, size_t bn)
 {
-	if (data_.get_size() == 0)
+	std::fill(r, r + an, 0);
+	for (size_t j = 0; j < bn; ++j)
+	{
+		r[j + an] = AddMulBlock(r + j, a, an, b[j]);
+	}
+}
+
+LN LN::Sqr(const LN &num)
+{
+	size_t n = num.data_.get_size();
+	if (n == 0)
+	{
+		return { 0LL };
+	}
+	else if (n == 1)
+	{
+		return SingleMul(num, num.data_[0]);
+	}
+	else if (n < tuning.toom3_sqr_threshold)
+	{
+		LN result;
+		result.data_.resize_uninitialized(2 * n);
+		MyDumbVector< Block > scratch;
+		scratch.resize_uninitialized(KaraScratchSize(n, tuning.karatsuba_sqr_threshold));
+		SqrBlocks(result.data_.get_data(), num.data_.get_data(), n, scratch.get_data());
+		result.Normalize();
+		return result;
+	}
+	else if (n >= tuning.ntt_sqr_threshold && NttFits(n, n))
+	{
+		return NttMul(num, num);
+	}
+	else if (n < tuning.toom4_sqr_threshold)
 	{
+		return Toom3Mul(num, num);
+	}
+	else
+	{
+		return Toom4Mul(num, num);
+	}
+}
+
+void LN::SchoolSqrBlocks(Block *r, const Block *a, size_t n)
+{
+	// every cross product a[i] a[j] with i < j once
+	std::fill(r, r + 2 * n, 0);
+	for (size_t i = 0; i + 1 < n; ++i)
+	{
+		r[i + n] = AddMulBlock(r + 2 * i + 1, a + i + 1, n - i - 1, a[i]);
+	}
+
+	// double them and add the squares on the diagonal in one pass
+	unsigned char carry = 0;
+	Block top = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		DoubleBlock sq = static_cast< DoubleBlock >(a[i]) * a[i];
+		Block lo = (r[2 * i] << 1) | top;
+		top = r[2 * i] >> (bits_in_block_ - 1);
+		Block hi = (r[2 * i + 1] << 1) | top;
+		top = r[2 * i + 1] >> (bits_in_block_ - 1);
+		r[2 * i] = AddCarry(lo, static_cast< Block >(sq), carry);
+		r[2 * i + 1] = AddCarry(hi, static_cast< Block >(sq >> bits_in_block_), carry);
+	}
+}
+
+// Karatsuba square: 2 a0 a1 = a0^2 + a1^2 - (a0 - a1)^2, so only squares recurse
+void LN::SqrBlocks(Block *r, const Block *a, size_t n, Block *scratch)
+{
+	if (n < std::max< size_t >(tuning.karatsuba_sqr_threshold, 2))
+	{
+		SchoolSqrBlocks(r, a, n);
 		return;
 	}
-	for (size_t i = 0; i < blocks; ++i)
+
+	size_t m = (n + 1) / 2;
+	Block *d = scratch;
+	Block *z1 = d + m;
+	Block *mid = z1 + 2 * m;
+	Block *rest = mid + 2 * m + 1;
+
+	if (CompareBlocks(a, m, a + m, n - m) < 0)
 	{
-		data_.push_back(0);
+		std::copy(a + m, a + n, d);
+		std::fill(d + (n - m), d + m, 0);
+		SubBlocks(d, d, m, a, m);
 	}
-	for (size_t i = data_.get_size(); i > blocks; --i)
+	else
 	{
-		std::swap(data_[i - 1], data_[i - blocks - 1]);
+		SubBlocks(d, a, m, a + m, n - m);
 	}
+
+	SqrBlocks(z1, d, m, rest);
+	SqrBlocks(r, a, m, rest);
+	SqrBlocks(r + 2 * m, a + m, n - m, rest);
+
+	std::copy(r, r + 2 * m, mid);
+	mid[2 * m] = AddBlocks(mid, mid, 2 * m, r + 2 * m, 2 * (n - m));
+	SubBlocks(mid, mid, 2 * m + 1, z1, 2 * m);
+
+	size_t mid_len = std::min(2 * m + 1, 2 * n - m);
+	AddBlocks(r + m, r + m, 2 * n - m, mid, mid_len);
 }
 
-LN LN::SingleMul(const LN &num1, Block num2)
+/*
+ * Karatsuba on block spans, the product goes straight to r and all temporaries
+ * live in scratch. With a = a1 * B^m + a0 and b = b1 * B^m + b0 it uses the
+ * subtractive form a0 b1 + a1 b0 = a0 b0 + a1 b1 - (a0 - a1)(b0 - b1), whose
+ * factors fit in m blocks and never carry.
+ */
+void LN::MulBlocks(Block *r, const Block *a, size_t an, const Block *b, size_t bn, Block *scratch)
 {
-	LN result;
+	if (bn < std::max< size_t >(tuning.karatsuba_threshold, 2))
+	{
+		SchoolMulBlocks(r, a, an, b, bn);
+		return;
+	}
 
-	size_t i;
-	size_t n = num1.data_.get_size();
+	if (an >= 2 * bn)
+	{
+		// pieces of bn blocks, every piece product is added on top of r
+		Block *piece = scratch;
+		MulBlocks(r, a, bn, b, bn, scratch + 2 * bn);
+		std::fill(r + 2 * bn, r + an + bn, 0);
+		for (size_t from = bn; from < an; from += bn)
+		{
+			size_t len = std::min(bn, an - from);
+			if (len >= bn)
+			{
+				MulBlocks(piece, a + from, len, b, bn, scratch + 2 * bn);
+			}
+			else
+			{
+				MulBlocks(piece, b, bn, a + from, len, scratch + 2 * bn);
+			}
+			AddBlocks(r + from, r + from, an + bn - from, piece, len + bn);
+		}
+		return;
+	}
 
-	Block carry = 0;
-	uint64_t er = static_cast< uint64_t >(num2);
+	size_t m = (an + 1) / 2;
+	if (bn <= m)
+	{
+		// b has no high half: a0 * b + a1 * b * B^m
+		Block *high = scratch;
+		MulBlocks(r, a, m, b, bn, scratch + 2 * m);
+		std::fill(r + m + bn, r + an + bn, 0);
+		MulBlocks(high, b, bn, a + m, an - m, scratch + 2 * m);
+		AddBlocks(r + m, r + m, an + bn - m, high, an - m + bn);
+		return;
+	}
 
-	for (i = 0; i < n || carry; ++i)
+	Block *da = scratch;
+	Block *db = da + m;
+	Block *z1 = db + m;
+	Block *mid = z1 + 2 * m;
+	Block *rest = mid + 2 * m + 1;
+
+	// |a0 - a1| and |b0 - b1|, the high halves are an - m and bn - m blocks
+	bool neg_a = CompareBlocks(a, m, a + m, an - m) < 0;
+	if (neg_a)
+	{
+		std::copy(a + m, a + an, da);
+		std::fill(da + (an - m), da + m, 0);
+		SubBlocks(da, da, m, a, m);
+	}
+	else
 	{
-		Block new_block;
+		SubBlocks(da, a, m, a + m, an - m);
+	}
+	bool neg_b = CompareBlocks(b, m, b + m, bn - m) < 0;
+	if (neg_b)
+	{
+		std::copy(b + m, b + bn, db);
+		std::fill(db + (bn - m), db + m, 0);
+		SubBlocks(db, db, m, b, m);
+	}
+	else
+	{
+		SubBlocks(db, b, m, b + m, bn - m);
+	}
 
-		uint64_t el = num1.get_block(i);
-		uint64_t ex = el * er + carry;
-		carry = 0;
-		new_block = static_cast< Block >(ex & std::numeric_limits< Block >::max());
-		carry = static_cast< Block >(ex >> sizeof(Block) * 8);
-		result.data_.push_back(new_block);
+	if (Forks(m))
+	{
+		// the three products write apart, the forked two with scratch of
+		// their own
+		Fork(
+			m,
+			3,
+			[&](size_t i)
+			{
+				if (i == 0)
+				{
+					MulBlocks(z1, da, m, db, m, rest);
+					return;
+				}
+				MyDumbVector< Block > own;
+				own.resize_uninitialized(KaraScratchSize(m, tuning.karatsuba_threshold));
+				if (i == 1)
+				{
+					MulBlocks(r, a, m, b, m, own.get_data());
+				}
+				else
+				{
+					MulBlocks(r + 2 * m, a + m, an - m, b + m, bn - m, own.get_data());
+				}
+			});
+	}
+	else
+	{
+		MulBlocks(z1, da, m, db, m, rest);
+		MulBlocks(r, a, m, b, m, rest);
+		MulBlocks(r + 2 * m, a + m, an - m, b + m, bn - m, rest);
+	}
+
+	// mid = z0 + z2 -+ z1, which is a0 b1 + a1 b0 and so never negative
+	std::copy(r, r + 2 * m, mid);
+	mid[2 * m] = AddBlocks(mid, mid, 2 * m, r + 2 * m, an + bn - 2 * m);
+	if (neg_a == neg_b)
+	{
+		SubBlocks(mid, mid, 2 * m + 1, z1, 2 * m);
+	}
+	else
+	{
+		AddBlocks(mid, mid, 2 * m + 1, z1, 2 * m);
 	}
 
+	size_t mid_len = std::min(2 * m + 1, an + bn - m);
+	AddBlocks(r + m, r + m, an + bn - m, mid, mid_len);
+}
+
+/*
+ * Toom-3 with the evaluation points 0, 1, -1, -2, inf and Bodrato's
+ * interpolation sequence. Intermediate values can be negative, so the signed
+ * LN operators are used; the product coefficients themselves are not.
+ */
+LN LN::Toom3Mul(const LN &num1, const LN &num2)
+{
+	size_t k = (std::max(num1.data_.get_size(), num2.data_.get_size()) + 2) / 3;
+
+	// values of the pieces of num at 0, 1, -1, -2, inf
+	struct Points
+	{
+		LN p0, p1, pm1, pm2, pinf;
+	};
+	auto evaluate = [k](const LN &num)
+	{
+		Points v;
+		v.p0 = num.Slice(0, k);
+		LN x1 = num.Slice(k, k);
+		v.pinf = num.Slice(2 * k, k);
+
+		LN t = v.p0 + v.pinf;
+		v.p1 = t + x1;
+		v.pm1 = t - x1;
+		v.pm2 = ((Lazy(v.pm1) + v.pinf) << 1) - v.p0;
+		return v;
+	};
+
+	// a square needs one evaluation, and Mul squares when both sides alias
+	Points a = evaluate(num1);
+	Points b_storage = &num1 == &num2 ? Points() : evaluate(num2);
+	const Points &b = &num1 == &num2 ? a : b_storage;
+
+	// the point products are independent, * keeps the signs of pm1 and pm2
+	const LN *left[] = { &a.p0, &a.p1, &a.pm1, &a.pm2, &a.pinf };
+	const LN *right[] = { &b.p0, &b.p1, &b.pm1, &b.pm2, &b.pinf };
+	LN products[5];
+	Fork(k, 5, [&](size_t i) { products[i] = *left[i] * *right[i]; });
+	LN &r0 = products[0];
+	LN &r1 = products[1];
+	LN &rm1 = products[2];
+	LN &rm2 = products[3];
+	LN &rinf = products[4];
+
+	LN c3 = rm2 - r1;
+	c3.DivExact(3);
+	LN c1 = r1 - rm1;
+	c1.ShiftRight(1);
+	LN c2 = rm1 - r0;
+	c3 = c2 - c3;
+	c3.ShiftRight(1);
+	c3 += Lazy(rinf) * 2;
+	c2 += Lazy(c1) - rinf;
+	c1 -= c3;
+
+	LN result = std::move(r0);
+	result.AddShifted(c1, k);
+	result.AddShifted(c2, 2 * k);
+	result.AddShifted(c3, 3 * k);
+	result.AddShifted(rinf, 4 * k);
 	return result;
 }
 
-LN LN::KaraMul(const LN &num1, const LN &num2)
+/*
+ * Toom-4 with the evaluation points 0, 1, -1, 2, -2, 1/2, inf (the value at 1/2
+ * is scaled by 2^6). The odd and even coefficients are separated from the
+ * symmetric pairs of points:
+ *   c2 + c4 = (r(1) + r(-1)) / 2 - c0 - c6
+ *   c2 + 4 c4 = ((r(2) + r(-2)) / 2 - c0 - 64 c6) / 4
+ *   c1 + c3 + c5 = (r(1) - r(-1)) / 2
+ *   c1 + 4 c3 + 16 c5 = (r(2) - r(-2)) / 4
+ *   16 c1 + 4 c3 + c5 = (64 r(1/2) - 64 c0 - 16 c2 - 4 c4 - c6) / 2
+ * and the two small systems are solved with exact divisions by 3 and 5.
+ */
+LN LN::Toom4Mul(const LN &num1, const LN &num2)
+{
+	size_t k = (std::max(num1.data_.get_size(), num2.data_.get_size()) + 3) / 4;
+
+	// values of the pieces of num at 0, 1, -1, 2, -2, 2^3 * (1/2), inf
+	struct Points
+	{
+		LN p0, p1, pm1, p2, pm2, ph, pinf;
+	};
+	auto evaluate = [k](const LN &num)
+	{
+		Points v;
+		v.p0 = num.Slice(0, k);
+		LN x1 = num.Slice(k, k);
+		LN x2 = num.Slice(2 * k, k);
+		v.pinf = num.Slice(3 * k, k);
+
+		LN even = v.p0 + x2;
+		LN odd = x1 + v.pinf;
+		v.p1 = even + odd;
+		v.pm1 = even - odd;
+
+		LN even2 = x2;
+		even2.ShiftLeft(2);
+		even2 += v.p0;
+		LN odd2 = v.pinf;
+		odd2.ShiftLeft(2);
+		odd2 += x1;
+		odd2.ShiftLeft(1);
+		v.p2 = even2 + odd2;
+		v.pm2 = even2 - odd2;
+
+		v.ph = v.p0;
+		v.ph.ShiftLeft(1);
+		v.ph += x1;
+		v.ph.ShiftLeft(1);
+		v.ph += x2;
+		v.ph.ShiftLeft(1);
+		v.ph += v.pinf;
+		return v;
+	};
+
+	Points a = evaluate(num1);
+	Points b_storage = &num1 == &num2 ? Points() : evaluate(num2);
+	const Points &b = &num1 == &num2 ? a : b_storage;
+
+	const LN *left[] = { &a.p0, &a.p1, &a.pm1, &a.p2, &a.pm2, &a.ph, &a.pinf };
+	const LN *right[] = { &b.p0, &b.p1, &b.pm1, &b.p2, &b.pm2, &b.ph, &b.pinf };
+	LN products[7];
+	Fork(k, 7, [&](size_t i) { products[i] = *left[i] * *right[i]; });
+	LN &r0 = products[0];
+	LN &r1 = products[1];
+	LN &rm1 = products[2];
+	LN &r2 = products[3];
+	LN &rm2 = products[4];
+	LN &rh = products[5];
+	LN &rinf = products[6];
+
+	LN e1 = r1 + rm1;
+	e1.ShiftRight(1);
+	e1 -= r0;
+	e1 -= rinf;
+	LN o1 = r1 - rm1;
+	o1.ShiftRight(1);
+
+	LN e2 = r2 + rm2;
+	e2.ShiftRight(1);
+	e2 -= r0;
+	LN t = rinf;
+	t.ShiftLeft(6);
+	e2 -= t;
+	e2.ShiftRight(2);
+	LN o2 = r2 - rm2;
+	o2.ShiftRight(2);
+
+	LN c4 = e2 - e1;
+	c4.DivExact(3);
+	LN c2 = e1 - c4;
+
+	LN h = rh - rinf;
+	t = r0;
+	t.ShiftLeft(6);
+	h -= t;
+	t = c2;
+	t.ShiftLeft(4);
+	h -= t;
+	t = c4;
+	t.ShiftLeft(2);
+	h -= t;
+	h.ShiftRight(1);
+
+	LN s1 = o2 - o1;	// c3 + 5 c5
+	s1.DivExact(3);
+	LN s2 = o1;	   // 4 c3 + 5 c5
+	s2.ShiftLeft(4);
+	s2 -= h;
+	s2.DivExact(3);
+	LN c3 = s2 - s1;
+	c3.DivExact(3);
+	LN c5 = s1 - c3;
+	c5.DivExact(5);
+	LN c1 = o1 - c3;
+	c1 -= c5;
+
+	LN result = std::move(r0);
+	result.AddShifted(c1, k);
+	result.AddShifted(c2, 2 * k);
+	result.AddShifted(c3, 3 * k);
+	result.AddShifted(c4, 4 * k);
+	result.AddShifted(c5, 5 * k);
+	result.AddShifted(rinf, 6 * k);
+	return result;
+}
+
+/*
+ * Square root with precision doubling: the root of the top half of the bits
+ * gives an estimate that is too large by less than a factor 1 + 2^-k, a single
+ * Newton step (x + n / x) / 2 from above then lands on floor(sqrt(n)) or one
+ * more, and the remainder n - x^2 tells which. Every level costs one division
+ * and one square of its own size, so the top level dominates.
+ */
+LN LN::SqrtRem(const LN &num, LN &rem)
+{
+	size_t bits = num.BitLength();
+	if (bits <= 64)
+	{
+		uint64_t v = 0;
+		for (size_t i = num.data_.get_size(); i-- > 0;)
+		{
+			if constexpr (bits_in_block_ < 64)
+			{
+				v <<= bits_in_block_;
+			}
+			v |= num.data_[i];
+		}
+		uint64_t s = static_cast< uint64_t >(std::sqrt(static_cast< double >(v)));
+		while (s > 0 && s > v / s)
+		{
+			--s;
+		}
+		while (s + 1 <= v / (s + 1))
+		{
+			++s;
+		}
+		LN root{ static_cast< long long >(s) };
+		rem = num - root.Square();
+		rem.sign_ = 1;
+		return root;
+	}
+
+	size_t k = (bits - 1) / 4;
+	LN high = num;
+	high.sign_ = 1;
+	high.ShiftRight(2 * k);
+	LN x = SqrtRem(high, rem);
+	x += 1LL;
+	x.ShiftLeft(k);
+
+	LN q;
+	Div(&q, nullptr, num, x);
+	x.AddAbs(q);
+	x.ShiftRight(1);
+
+	rem = num - x.Square();
+	while (rem.sign_ == -1 && rem.data_.get_size() != 0)
+	{
+		// (x - 1)^2 = x^2 - 2x + 1
+		rem += x;
+		rem += x;
+		rem -= 1LL;
+		x -= 1LL;
+	}
+	return x;
+}
+
+void LN::Div(LN *q, LN *r, const LN &u, const LN &v)
+{
+	size_t m = u.data_.get_size();
+	size_t n = v.data_.get_size();
+	size_t threshold = std::max< size_t >(tuning.burnikel_ziegler_threshold, 2);
+	if (u.is_nan_ || v.is_nan_ || n < threshold || m < n + threshold)
+	{
+		divmnu(q, r, u, v);
+		return;
+	}
+
+	// shift both so the top bit of the divisor is set, the quotient is kept
+	// and the remainder is shifted back
+	int s = std::countl_zero(v.data_[n - 1]);
+	LN a = u;
+	a.sign_ = 1;
+	a.ShiftLeft(s);
+	LN b = v;
+	b.sign_ = 1;
+	b.ShiftLeft(s);
+
+	LN rem;
+	LN quot = BurnikelZiegler(a, b, rem);
+	rem.ShiftRight(s);
+	if (q != nullptr)
+	{
+		q->data_ = std::move(quot.data_);
+	}
+	if (r != nullptr)
+	{
+		r->data_ = std::move(rem.data_);
+	}
+}
+
+/*
+ * Burnikel-Ziegler recursive division. The dividend is consumed in digits of
+ * the divisor's size n from the top, each step divides a 2n-block number by
+ * the n-block divisor, which in turn splits into two 3-by-2 half-size steps.
+ * A 3-by-2 step estimates the quotient from the top halves recursively and
+ * fixes it with one half-size multiplication, so the whole division costs
+ * about 2 M(n) log n.
+ */
+LN LN::BurnikelZiegler(const LN &a, const LN &b, LN &rem)
 {
-	if (num1.data_.get_size() == 0 || num2.data_.get_size() == 0)
+	size_t m = a.data_.get_size();
+	size_t n = b.data_.get_size();
+	if (m < n)
 	{
+		rem = a;
 		return { 0LL };
 	}
-	else if (num1.data_.get_size() == 1)
+
+	size_t k = m - n + 1;
+	if (k + 1 < n)
+	{
+		// a short quotient only depends on the top k + 1 blocks of the divisor:
+		// with its top bit set the truncated quotient is q or q + 1
+		size_t t = n - k - 1;
+		LN q = BurnikelZiegler(a.Slice(t, m - t), b.Slice(t, n - t), rem);
+		LN product = Mul(q, b);
+		rem = a;
+		rem -= product;
+		if (rem.sign_ == -1)
+		{
+			rem += b;
+			q -= 1LL;
+		}
+		return q;
+	}
+
+	size_t digits = (m + n - 1) / n;
+	LN top = a.Slice((digits - 1) * n, n);
+	LN q;
+	LN r;
+	if (top.abs_compare(b) == std::strong_ordering::less)
 	{
-		return SingleMul(num2, num1.data_[0]);
+		r = std::move(top);
+		--digits;
 	}
-	else if (num2.data_.get_size() == 1)
+	for (size_t i = digits; i-- > 0;)
 	{
-		return SingleMul(num1, num2.data_[0]);
+		((Lazy(r) << n * bits_in_block_) + a.Slice(i * n, n)).Evaluate(r);
+		q.AddShifted(Div2n1n(r, b, n, r), i * n);
 	}
-	LN h1, h2, l1, l2;
-	size_t m = std::max(num1.data_.get_size(), num2.data_.get_size()) / 2;
-	num1.Split(h1, l1, m);
-	num2.Split(h2, l2, m);
-	LN z2 = KaraMul(h1, h2);
-	LN z0 = KaraMul(l1, l2);
-	LN z1 = KaraMul(l1 + h1, l2 + h2) - z2 - z0;
-	z2.BlockShift(m);
-	z2 += z1;
-	z2.BlockShift(m);
-	z2 += z0;
-	return z2;
+	rem = std::move(r);
+	return q;
 }
 
-void LN::Split(LN &high, LN &low, size_t m) const
+LN LN::Div2n1n(const LN &a, const LN &b, size_t n, LN &rem)
 {
-	size_t n = data_.get_size();
-	for (size_t i = 0; i < std::min(m, n); ++i)
+	if (n < std::max< size_t >(tuning.burnikel_ziegler_threshold, 2))
 	{
-		low.data_.push_back(data_[i]);
+		LN q;
+		divmnu(&q, &rem, a, b);
+		return q;
 	}
-	for (size_t i = m; i < n; ++i)
+	if (n % 2 == 1)
 	{
-		high.data_.push_back(data_[i]);
+		// one more zero block at the bottom evens the halves out and keeps
+		// the divisor normalized
+		LN a2 = a;
+		a2.ShiftLeft(bits_in_block_);
+		LN b2 = b;
+		b2.ShiftLeft(bits_in_block_);
+		LN q = Div2n1n(a2, b2, n + 1, rem);
+		rem.ShiftRight(bits_in_block_);
+		return q;
 	}
+
+	// a = [a1 a2 a3 a4] in halves, [a1 a2 a3] / b then [r a4] / b
+	size_t half = n / 2;
+	LN r;
+	LN q1 = Div3n2n(a.Slice(half, 3 * half), b, half, r);
+	((Lazy(r) << half * bits_in_block_) + a.Slice(0, half)).Evaluate(r);
+	LN q = Div3n2n(r, b, half, rem);
+	q.AddShifted(q1, half);
+	return q;
+}
+
+LN LN::Div3n2n(const LN &a, const LN &b, size_t half, LN &rem)
+{
+	// a = [a1 a2 a3], b = [b1 b2] in halves
+	LN b1 = b.Slice(half, half);
+	LN b2 = b.Slice(0, half);
+	LN a12 = a.Slice(half, 2 * half);
+	LN a3 = a.Slice(0, half);
+
+	LN q;
+	LN c;
+	if (a.Slice(2 * half, half).abs_compare(b1) == std::strong_ordering::less)
+	{
+		q = Div2n1n(a12, b1, half, c);
+	}
+	else
+	{
+		// a1 == b1, the estimate saturates at 2^(half * bits_in_block_) - 1
+		// and c = a12 - q * b1 = a12 - b1 * 2^(half * bits_in_block_) + b1
+		q.data_.resize_uninitialized(half);
+		std::fill(q.data_.get_data(), q.data_.get_data() + half, std::numeric_limits< Block >::max());
+		c = Lazy(a12) - (Lazy(b1) << half * bits_in_block_) + b1;
+	}
+
+	// [c a3] - q * b2 is the true remainder, less than b below zero at most twice
+	((Lazy(c) << half * bits_in_block_) + a3).Evaluate(c);
+	c -= LazyProduct(q, b2);
+	while (c.sign_ == -1)
+	{
+		c += b;
+		q -= 1LL;
+	}
+	rem = std::move(c);
+	return q;
 }
 
 /*
  * solves (u = v * q + r) for known u v
- * q -- quotitent
+ * q -- quotitent (can be null if not needed)
  * r -- remainder (can be null if not needed)
  * u -- divident
  * v -- divisor
+ * q and r keep their capacity, so a destination reused in a loop stops
+ * allocating once it is large enough
  */
 void LN::divmnu(LN *q, LN *r, const LN &u, const LN &v)
 {
-	if (q == nullptr)
+	if (u.is_nan_ || v.is_nan_ || v.data_.get_size() == 0)
 	{
-		return;
-	}
-	if (v == LN{ 0LL })
-	{
-		q->is_nan_ = true;
+		if (q != nullptr)
+		{
+			q->is_nan_ = true;
+		}
 		if (r != nullptr)
 		{
 			r->is_nan_ = true;
@@ -636,153 +1608,146 @@ void LN::divmnu(LN *q, LN *r, const LN &u, const LN &v)
 
 	if (m < n)
 	{
-		*q = { 0LL };
+		// q may be u
 		if (r != nullptr)
 		{
-			*r = u;
+			r->data_ = u.data_;
+		}
+		if (q != nullptr)
+		{
+			q->data_.resize(0);
 		}
 		return;
 	}
 	else if (n <= 1)
 	{
-		auto qdata = MyDumbVector< Block >(m);
-		uint64_t vb = v.data_[0];
-		uint64_t carry = 0;
-		for (int i = m - 1; i >= 0; --i)
+		// block i of u is read before block i of q is written, so q may be u
+		Block vb = v.data_[0];
+		Block carry = 0;
+		if (q != nullptr)
 		{
-			uint64_t x = carry << sizeof(Block) * 8 | u.data_[i];
-			carry = x % vb;
-			x /= vb;
-			qdata[i] = x;
+			q->data_.resize_uninitialized(m);
 		}
-		while (q->data_.get_size() != 0 && qdata[q->data_.get_size() - 1] == 0)
+		for (size_t i = m; i-- > 0;)
 		{
-			qdata.pop();
+			DoubleBlock x = static_cast< DoubleBlock >(carry) << bits_in_block_ | u.data_[i];
+			carry = static_cast< Block >(x % vb);
+			if (q != nullptr)
+			{
+				q->data_[i] = static_cast< Block >(x / vb);
+			}
+		}
+		if (q != nullptr)
+		{
+			q->Normalize();
 		}
-		q->data_ = std::move(qdata);
-		if (r)
+		if (r != nullptr)
 		{
-			*r = LN{};
+			r->data_.resize(carry != 0 ? 1 : 0);
 			if (carry != 0)
 			{
-				r->data_.push_back(carry);
+				r->data_[0] = carry;
 			}
 		}
 		return;
 	}
 
-	const uint64_t b = static_cast< uint64_t >(1) << (sizeof(Block) * 8);
+	const DoubleBlock b = static_cast< DoubleBlock >(1) << bits_in_block_;
 
-	int s = nlz1(v.data_[n - 1]);
-	uint32_t *vn = new uint32_t[4 * n]();
-	uint32_t *un = new uint32_t[4 * (m + 1)]();
-	for (int i = n - 1; i > 0; i--)
+	// the normalized copies live in a per-thread buffer that only grows; it
+	// outlives any scoped resource, so it stays on the global heap
+	thread_local MyDumbVector< Block > workspace(std::pmr::new_delete_resource());
+	if (workspace.get_size() < n + m + 1)
 	{
-		vn[i] = (v.data_[i] << s) | (static_cast< uint64_t >(v.data_[i - 1]) >> (32 - s));
+		workspace.resize_uninitialized(n + m + 1);
+	}
+	Block *vn = workspace.get_data();
+	Block *un = vn + n;
+
+	// shifts through DoubleBlock keep s == 0 well defined
+	int s = std::countl_zero(v.data_[n - 1]);
+	for (size_t i = n - 1; i > 0; i--)
+	{
+		vn[i] = (v.data_[i] << s) |
+				static_cast< Block >(static_cast< DoubleBlock >(v.data_[i - 1]) >> (bits_in_block_ - s));
 	}
 
 	vn[0] = v.data_[0] << s;
 
-	un[m] = static_cast< uint64_t >(u.data_[m - 1]) >> (32 - s);
+	un[m] = static_cast< Block >(static_cast< DoubleBlock >(u.data_[m - 1]) >> (bits_in_block_ - s));
 
-	for (int i = m - 1; i > 0; --i)
+	for (size_t i = m - 1; i > 0; --i)
 	{
-		un[i] = (u.data_[i] << s) | (static_cast< uint64_t >(u.data_[i - 1]) >> (32 - s));
+		un[i] = (u.data_[i] << s) |
+				static_cast< Block >(static_cast< DoubleBlock >(u.data_[i - 1]) >> (bits_in_block_ - s));
 	}
 
 	un[0] = u.data_[0] << s;
 
-	uint64_t qhat;
-	uint64_t rhat;
-	uint64_t p;
-	int64_t t, k;
-
-	q->data_ = MyDumbVector< Block >(m - n + 1);
-	for (int j = m - n; j >= 0; --j)
+	if (q != nullptr)
 	{
-		qhat = (un[j + n] * b + un[j + n - 1]) / vn[n - 1];
-		rhat = (un[j + n] * b + un[j + n - 1]) - qhat * vn[n - 1];
+		q->data_.resize_uninitialized(m - n + 1);
+	}
+	for (size_t j = m - n + 1; j-- > 0;)
+	{
+		DoubleBlock num = static_cast< DoubleBlock >(un[j + n]) << bits_in_block_ | un[j + n - 1];
+		DoubleBlock qhat = num / vn[n - 1];
+		DoubleBlock rhat = num - qhat * vn[n - 1];
 
-		do
+		while (qhat >= b || qhat * vn[n - 2] > (rhat << bits_in_block_ | un[j + n - 2]))
 		{
-			if (qhat >= b || (qhat * vn[n - 2] > b * rhat + un[j + n - 2]))
+			--qhat;
+			rhat += vn[n - 1];
+			if (rhat >= b)
 			{
-				--qhat;
-				rhat += vn[n - 1];
-				if (rhat < b)
-				{
-					continue;
-				}
+				break;
 			}
-		} while (false);
+		}
 
-		k = 0;
-		for (int i = 0; i < n; ++i)
+		// un[j..j+n] -= qhat * vn
+		Block k = 0;
+		unsigned char borrow = 0;
+		for (size_t i = 0; i < n; ++i)
 		{
-			p = qhat * vn[i];
-			t = un[i + j] - k - (p & 0xFFFFFFFFULL);
-			un[i + j] = t;
-			k = (p >> 32) - (t >> 32);
+			DoubleBlock p = qhat * vn[i] + k;
+			k = static_cast< Block >(p >> bits_in_block_);
+			un[i + j] = SubBorrow(un[i + j], static_cast< Block >(p), borrow);
 		}
+		un[j + n] = SubBorrow(un[j + n], k, borrow);
 
-		t = un[j + n] - k;
-		un[j + n] = t;
-
-		q->data_[j] = qhat;
-		if (t < 0)
+		if (borrow)
 		{
-			--q->data_[j];
-			k = 0;
-			for (int i = 0; i < n; ++i)
+			// qhat was one too large, add the divisor back
+			--qhat;
+			unsigned char carry = 0;
+			for (size_t i = 0; i < n; ++i)
 			{
-				t = static_cast< uint64_t >(un[i + j]) + vn[i] + k;
-				un[i + j] = t;
-				k = t >> 32;
+				un[i + j] = AddCarry(un[i + j], vn[i], carry);
 			}
-			un[j + n] += k;
+			un[j + n] += carry;
+		}
+		if (q != nullptr)
+		{
+			q->data_[j] = static_cast< Block >(qhat);
 		}
 	}
 
-	while (q->data_.get_size() != 0 && q->data_[q->data_.get_size() - 1] == 0)
+	if (q != nullptr)
 	{
-		q->data_.pop();
+		q->Normalize();
 	}
 
 	if (r != nullptr)
 	{
-		r->data_ = MyDumbVector< Block >(n);
-		for (int i = 0; i < n - 1; ++i)
+		r->data_.resize_uninitialized(n);
+		for (size_t i = 0; i < n - 1; ++i)
 		{
-			r->data_[i] = (un[i] >> s) | (static_cast< uint64_t >(un[i + 1]) << (32 - s));
+			r->data_[i] = (un[i] >> s) |
+						  static_cast< Block >(static_cast< DoubleBlock >(un[i + 1]) << (bits_in_block_ - s));
 		}
 		r->data_[n - 1] = un[n - 1] >> s;
-		while (r->data_.get_size() != 0 && r->data_[r->data_.get_size() - 1] == 0)
-		{
-			r->data_.pop();
-		}
+		r->Normalize();
 	}
-
-	delete[] un;
-	delete[] vn;
-}
-
-const uint32_t *LN::tr_16_char_to_int()
-{
-	static bool called = false;
-	static uint32_t res[256];
-	if (!called)
-	{
-		for (size_t i = 0; i < 256; ++i)
-		{
-			res[i] = 0xffffffff;
-		}
-		for (uint32_t i = 0; i < sizeof(HEX_DIGITS); ++i)
-		{
-			res[HEX_DIGITS[i]] = i;
-		}
-		called = true;
-	}
-	return res;
 }
 
 LN operator""_ln(const char *str)
@@ -4,17 +4,35 @@
 #include <string_view>
 
 #include <algorithm>
+#include <bit>
 #include <cassert>
-#include <cctype>
 #include <cinttypes>
+#include <cmath>
 #include <cstdint>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <limits>
 #include <stack>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 
+// 64-bit blocks need a double-width type for the carry/product kernels; define
+// LN_32BIT_BLOCKS to force the portable 32-bit representation. Windows keeps
+// 32-bit blocks: clang for the MSVC ABI has __int128 but does not link the
+// runtime routines that divide it (__udivti3, __umodti3).
+#if defined(__SIZEOF_INT128__) && !defined(_WIN32) && !defined(LN_32BIT_BLOCKS)
+#	define LN_64BIT_BLOCKS 1
+#endif
+
+class ThreadPool;
+struct LNTerm;
+template< size_t N >
+class LNExpr;
+class LNProduct;
+class ModContext;
+
 class LN
 {
   public:
@@ -27,9 +45,17 @@ class LN
 	LN &operator=(const LN &other) = default;
 	LN &operator=(LN &&other) = default;
 
-	LN operator+(const LN &other) const;
+	// the rvalue overloads of + and - compute in place in the buffer of an
+	// operand that is about to die instead of allocating the result
+	LN operator+(const LN &other) const &;
+	LN operator+(const LN &other) &&;
+	LN operator+(LN &&other) const &;
+	LN operator+(LN &&other) &&;
 	LN &operator+=(const LN &other);
-	LN operator-(const LN &other) const;
+	LN operator-(const LN &other) const &;
+	LN operator-(const LN &other) &&;
+	LN operator-(LN &&other) const &;
+	LN operator-(LN &&other) &&;
 	LN &operator-=(const LN &other);
 	LN operator*(const LN &other) const;
 	LN &operator*=(const LN &other);
@@ -37,7 +63,8 @@ class LN
 	LN &operator/=(const LN &other);
 	LN operator%(const LN &other) const;
 	LN &operator%=(const LN &other);
-	LN operator-() const;
+	LN operator-() const &;
+	LN operator-() &&;
 	LN operator~() const;
 
 	std::partial_ordering operator<=>(const LN &other) const;
@@ -53,14 +80,92 @@ class LN
 
 	bool IsNaN() const;
 	std::string ToString() const;
+	// the same text as ToString without building a string (Hex.cpp);
+	// WriteTo(char *) needs StringLength() chars and returns the end
+	size_t StringLength() const;
+	char *WriteTo(char *out) const;
+	void WriteTo(std::ostream &out) const;
+	// text in any base from 2 to 36 (Radix.cpp): digits, then letters of
+	// either case, with an optional '-'; NaN when a character is not a digit
+	// of base, std::domain_error for a base out of range
+	static LN FromString(std::string_view text, unsigned base);
+	std::string ToString(unsigned base) const;
+	// binary form (Binary.cpp): a little-endian 64-bit word holding
+	// limbs << 2 | NaN << 1 | negative, then the magnitude as that many
+	// little-endian 64-bit limbs, least significant first;
+	// WriteBinary(char *) needs BinarySize() bytes and returns the end
+	size_t BinarySize() const;
+	char *WriteBinary(char *out) const;
+	void WriteBinary(std::ostream &out) const;
+	// one value from [begin, end), returns where it ends or nullptr if the
+	// record is truncated or malformed
+	static const char *ReadBinary(const char *begin, const char *end, LN &value);
 	static LN GetNaN();
 
+	// quotient and remainder of one division, the same as num / den and
+	// num % den; the outputs may be num or den but not the same object
+	static std::pair< LN, LN > DivMod(const LN &num, const LN &den);
+	static void DivMod(const LN &num, const LN &den, LN &quotient, LN &remainder);
+
+	// base^exp mod |mod| in [0, |mod|) by sliding windows over the bits of exp
+	// (PowMod.cpp); NaN for a zero modulus or a negative exponent. A
+	// ModContext (PowMod.h) keeps the precomputation for one modulus
+	static LN PowMod(const LN &base, const LN &exp, const LN &mod);
+	static LN PowMod(const LN &base, const LN &exp, const ModContext &context);
+
+	LN Square() const;
+	// floor of the square root, the remainder this - root^2 goes to remainder
+	// when it is not null; NaN for negative numbers
+	LN Sqrt(LN *remainder = nullptr) const;
+
+	// thresholds (in blocks of the shorter operand) at which multiplication
+	// switches to the next algorithm:
+	// schoolbook -> Karatsuba -> Toom-3 -> Toom-4 -> NTT
+	// squaring has its own set since its schoolbook is about twice as fast;
+	// division leaves Algorithm D for Burnikel-Ziegler once both the divisor
+	// and the quotient reach burnikel_ziegler_threshold blocks; products
+	// whose pieces reach parallel_threshold blocks run the products of the
+	// pieces on LN::threads
+	struct Tuning
+	{
+		size_t karatsuba_threshold;
+		size_t toom3_threshold;
+		size_t toom4_threshold;
+		size_t ntt_threshold;
+		size_t karatsuba_sqr_threshold;
+		size_t toom3_sqr_threshold;
+		size_t toom4_sqr_threshold;
+		size_t ntt_sqr_threshold;
+		size_t burnikel_ziegler_threshold;
+		size_t parallel_threshold;
+	};
+	static Tuning tuning;
+	// the pool large multiplications fork onto, none by default; forking only
+	// happens while the limbs come from the global heap, which unlike the
+	// pools of LimbMemory.h can be used from any thread
+	static ThreadPool *threads;
+
+	// times the algorithms around each threshold on this machine, reports the
+	// measurements to log and returns the crossover points found (Calibrate.cpp)
+	static Tuning Calibrate(std::ostream &log);
+
   private:
+	template< size_t N >
+	friend class LNExpr;
+	friend class LNProduct;
+	friend class ModContext;
+
+#ifdef LN_64BIT_BLOCKS
+	using Block = uint64_t;
+	using DoubleBlock = unsigned __int128;
+#else
 	using Block = uint32_t;
+	using DoubleBlock = uint64_t;
+#endif
+	static constexpr size_t bits_in_block_ = sizeof(Block) * 8;
 	static constexpr size_t bits_in_digit_ = 4;
-	static constexpr size_t digits_in_block_ = sizeof(Block) * 8 / bits_in_digit_;
+	static constexpr size_t digits_in_block_ = bits_in_block_ / bits_in_digit_;
 
-	static const uint32_t *tr_16_char_to_int();
 	int sign_ = 1;
 	bool is_nan_ = false;
 	MyDumbVector< Block > data_;
@@ -73,47 +178,105 @@ class LN
 
 	Block get_block(size_t i) const;
 
-	void Div2();
+	// a + b + carry, carry is updated in place
+	static Block AddCarry(Block a, Block b, unsigned char &carry);
+	// a - b - borrow, borrow is updated in place
+	static Block SubBorrow(Block a, Block b, unsigned char &borrow);
+
+	// drops leading zero blocks
+	void Normalize();
+	size_t BitLength() const;
+	void ShiftLeft(size_t bits);
+	void ShiftRight(size_t bits);
+	// divides the magnitude by an odd d, which must divide it exactly
+	void DivExact(Block d);
+	// |*this| += |src| * 2^(blocks * bits_in_block_)
+	void AddShifted(const LN &src, size_t blocks);
+	// blocks [from, from + count) as a normalized number
+	LN Slice(size_t from, size_t count) const;
+
+	// r = a + b for an >= bn, returns the carry out; r may alias a or b
+	static Block AddBlocks(Block *r, const Block *a, size_t an, const Block *b, size_t bn);
+	// r = a - b for a >= b (so an >= bn), returns the borrow out; r may alias a or b
+	static Block SubBlocks(Block *r, const Block *a, size_t an, const Block *b, size_t bn);
+
+	// |*this| += |other|, sign is kept
+	void AddAbs(const LN &other);
+	// |*this| -= |other|, sign is flipped if |other| is larger
+	void SubAbs(const LN &other);
+
 	static LN SaneAdd(const LN &left, const LN &right);
 
 	// left > right
 	static LN SaneSub(const LN &left, const LN &right);
 
-	void BlockShift(size_t blocks);
+	// r[0, n) += a[0, n) * b, returns the carry out
+	static Block AddMulBlock(Block *r, const Block *a, size_t n, Block b);
 	static LN SingleMul(const LN &num1, Block num2);
+	// sign of a - b, the spans may have leading zero blocks
+	static int CompareBlocks(const Block *a, size_t an, const Block *b, size_t bn);
 
+	// |num1| * |num2|, picks the algorithm by the operand sizes and squares
+	// equal operands
+	static LN Mul(const LN &num1, const LN &num2);
+	// |num|^2, the Toom and NTT multiplications square when passed num twice
+	static LN Sqr(const LN &num);
 	static LN KaraMul(const LN &num1, const LN &num2);
-	void Split(LN &high, LN &low, size_t m) const;
+	// r[0, an + bn) = a * b for an >= bn >= 1, no allocations
+	static void SchoolMulBlocks(Block *r, const Block *a, size_t an, const Block *b, size_t bn);
+	// same as above, schoolbook or Karatsuba; scratch holds
+	// KaraScratchSize(an, tuning.karatsuba_threshold) blocks and r must not
+	// overlap the operands
+	static void MulBlocks(Block *r, const Block *a, size_t an, const Block *b, size_t bn, Block *scratch);
+	static size_t KaraScratchSize(size_t n, size_t threshold);
+	// r[0, 2n) = a^2, no allocations
+	static void SchoolSqrBlocks(Block *r, const Block *a, size_t n);
+	// schoolbook or Karatsuba square, scratch as for MulBlocks with
+	// tuning.karatsuba_sqr_threshold
+	static void SqrBlocks(Block *r, const Block *a, size_t n, Block *scratch);
+	// whether a product split into pieces of blocks blocks forks
+	static bool Forks(size_t blocks);
+	// task(0) ... task(count - 1), on threads if Forks(blocks) and in order
+	// otherwise; the first exception a task throws is rethrown
+	static void Fork(size_t blocks, size_t count, const std::function< void(size_t) > &task);
+	static LN Toom3Mul(const LN &num1, const LN &num2);
+	static LN Toom4Mul(const LN &num1, const LN &num2);
+	// NTT.cpp, squares when num1 and num2 are the same object
+	static bool NttFits(size_t n1, size_t n2);
+	static LN NttMul(const LN &num1, const LN &num2);
 
+	// |u| / |v| and |u| % |v| (either may be null), picks the algorithm by
+	// the operand sizes; only the magnitudes of q and r are written and
+	// either may be u or v
+	static void Div(LN *q, LN *r, const LN &u, const LN &v);
 	static void divmnu(LN *q, LN *r, const LN &u, const LN &v);
+	// Burnikel-Ziegler for a divisor b with its top bit set, rem may be a
+	static LN BurnikelZiegler(const LN &a, const LN &b, LN &rem);
+	// a < b * 2^(n * bits_in_block_) for an n-block normalized b
+	static LN Div2n1n(const LN &a, const LN &b, size_t n, LN &rem);
+	// a < b * 2^(half * bits_in_block_) for a 2 * half-block normalized b
+	static LN Div3n2n(const LN &a, const LN &b, size_t half, LN &rem);
+	// floor(sqrt(|num|)) and |num| - root^2
+	static LN SqrtRem(const LN &num, LN &rem);
 
-	template< typename Iter >
-	void FromStringLike(Iter begin, Iter end)
-	{
-		if (end == begin)
-		{
-			is_nan_ = true;
-		}
-		while (end > begin)
-		{
-			Block b = 0;
-			size_t block_size = std::min< size_t >(end - begin, digits_in_block_);
-			auto block_start = end - block_size;
-			for (auto digit = block_start; digit < end; ++digit)
-			{
-				b <<= bits_in_digit_;
-				Block dig_number = tr_16_char_to_int()[std::toupper(*digit)];
-				if (dig_number == 0xffffffff)
-				{
-					is_nan_ = true;
-					return;
-				}
-				b |= dig_number;
-			}
-			data_.push_back(b);
-			end = block_start;
-		}
-	}
+	// base^(k * 2^level) for the divide-and-conquer radix conversion, k being
+	// fixed per base; computed on first use and kept (Radix.cpp)
+	static const LN &RadixPower(unsigned base, size_t level);
+	// the digits of num < RadixPower(base, level), padded with zeros to the
+	// full width of the level when pad is set
+	static char *WriteRadix(const LN &num, unsigned base, size_t level, char *out, bool pad);
+
+	// dest = the sum of the terms in one pass over the limbs, dest may be one
+	// of them (LNExpr.cpp)
+	static void Fuse(LN &dest, const LNTerm *terms, size_t count);
+	// dest += left * right, or -= when negative is set
+	static void FuseProduct(LN &dest, const LN &left, const LN &right, bool negative);
+
+	// hex digits, most significant first (Hex.cpp); NaN on anything else
+	void FromStringLike(const char *begin, const char *end);
 };
 
+// containers of LN move their elements when they grow instead of copying
+static_assert(std::is_nothrow_move_constructible_v< LN >);
+
 LN operator""_ln(const char *str);
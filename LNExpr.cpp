@@ -0,0 +1,215 @@
+#include "LNExpr.h"
+
+namespace
+{
+	// x * m + carry for a 64-bit m: the low block is returned and the rest,
+	// which always fits 64 bits, goes to carry
+	template< typename Block, typename DoubleBlock >
+	Block MulStep(Block x, uint64_t m, uint64_t &carry)
+	{
+		if constexpr (sizeof(Block) == sizeof(uint64_t))
+		{
+			DoubleBlock t = static_cast< DoubleBlock >(x) * m + carry;
+			carry = static_cast< uint64_t >(t >> 64);
+			return static_cast< Block >(t);
+		}
+		else
+		{
+			uint64_t low = static_cast< uint64_t >(x) * static_cast< uint32_t >(m) + static_cast< uint32_t >(carry);
+			carry = static_cast< uint64_t >(x) * (m >> 32) + (carry >> 32) + (low >> 32);
+			return static_cast< Block >(low);
+		}
+	}
+}	 // namespace
+
+void LN::Fuse(LN &dest, const LNTerm *terms, size_t count)
+{
+	// a term as the pass reads it: its blocks move up by blocks and bits,
+	// previous is the block below the current one for the bits that cross
+	// over, carry the part of the product above the current block
+	struct Stream
+	{
+		const LN *value;
+		const Block *data;
+		size_t size;
+		size_t blocks;
+		size_t bits;
+		uint64_t multiplier;
+		uint64_t carry;
+		Block previous;
+		bool negative;
+	};
+
+	MyDumbVector< Stream, 8 > streams;
+	size_t length = 0;
+	bool in_place = true;
+	for (size_t j = 0; j < count; ++j)
+	{
+		const LN &value = *terms[j].value;
+		if (value.is_nan_)
+		{
+			dest = NaN_;
+			return;
+		}
+		size_t n = value.data_.get_size();
+		if (n == 0 || terms[j].multiplier == 0)
+		{
+			continue;
+		}
+		size_t blocks = terms[j].shift / bits_in_block_;
+		streams.push_back({ &value, nullptr, n, blocks, terms[j].shift % bits_in_block_, terms[j].multiplier, 0, 0,
+							terms[j].negative != (value.sign_ == -1) });
+		// one block for the bits shifted out of the top, the multiplier, and
+		// one for the carries of adding up to 2^bits_in_block_ terms
+		length = std::max(length, n + blocks + 2 + sizeof(uint64_t) / sizeof(Block));
+		// a tile of dest is written once all terms have read it, a term
+		// reading dest at lower positions needs a separate result
+		in_place = in_place && (&value != &dest || blocks == 0);
+	}
+	if (!in_place)
+	{
+		LN result;
+		Fuse(result, terms, count);
+		dest = std::move(result);
+		return;
+	}
+
+	// dest keeps its blocks in case it is a term
+	dest.data_.resize_uninitialized(length);
+	Block *r = dest.data_.get_data();
+	for (size_t j = 0; j < streams.get_size(); ++j)
+	{
+		streams[j].data = streams[j].value->data_.get_data();
+	}
+
+	// the result is summed a tile at a time in a buffer that stays in the
+	// cache, so every block of it is written to memory once; carry is what
+	// the tiles below pass up, at most the number of terms either way
+	constexpr size_t tile = 256;
+	Block sum[tile];
+	Block shifted[tile];
+	long long carry = 0;
+	for (size_t from = 0; from < length; from += tile)
+	{
+		size_t n = std::min(tile, length - from);
+		// carry sign-extended over the tile, high is the part above it
+		std::fill(sum, sum + n, carry < 0 ? ~Block(0) : 0);
+		sum[0] = static_cast< Block >(carry);
+		long long high = carry < 0 ? -1 : 0;
+
+		for (size_t j = 0; j < streams.get_size(); ++j)
+		{
+			Stream &s = streams[j];
+			// the tile holds zeros below the term, then its blocks from
+			// first on, then zeros
+			size_t zeros = std::min(n, s.blocks > from ? s.blocks - from : 0);
+			size_t first = std::min(from + zeros - s.blocks, s.size);
+			size_t blocks = std::min(n - zeros, s.size - first);
+			if (s.bits == 0 && s.multiplier == 1)
+			{
+				Block *at = sum + zeros;
+				high += s.negative ? -static_cast< long long >(SubBlocks(at, at, n - zeros, s.data + first, blocks))
+								   : static_cast< long long >(AddBlocks(at, at, n - zeros, s.data + first, blocks));
+				continue;
+			}
+
+			// one step per block; the state is copied out of s, which the
+			// compiler would otherwise reload after every store to shifted
+			size_t bits = s.bits;
+			uint64_t multiplier = s.multiplier;
+			uint64_t mul_carry = s.carry;
+			Block previous = s.previous;
+			auto step = [&](Block current)
+			{
+				Block v = current;
+				if (bits != 0)
+				{
+					v = current << bits | previous >> (bits_in_block_ - bits);
+					previous = current;
+				}
+				return multiplier != 1 ? MulStep< Block, DoubleBlock >(v, multiplier, mul_carry) : v;
+			};
+			std::fill(shifted, shifted + zeros, 0);
+			const Block *src = s.data + first;
+			for (size_t i = 0; i < blocks; ++i)
+			{
+				shifted[zeros + i] = step(src[i]);
+			}
+			for (size_t i = zeros + blocks; i < n; ++i)
+			{
+				shifted[i] = step(0);
+			}
+			s.carry = mul_carry;
+			s.previous = previous;
+			high += s.negative ? -static_cast< long long >(SubBlocks(sum, sum, n, shifted, n))
+							   : static_cast< long long >(AddBlocks(sum, sum, n, shifted, n));
+		}
+		std::copy_n(sum, n, r + from);
+		carry = high;
+	}
+
+	dest.is_nan_ = false;
+	dest.sign_ = 1;
+	if (carry < 0)
+	{
+		// a negative sum is left in two's complement
+		Block one = 1;
+		for (size_t i = 0; i < length; ++i)
+		{
+			r[i] = ~r[i] + one;
+			one &= r[i] == 0;
+		}
+		dest.sign_ = -1;
+	}
+	dest.Normalize();
+	if (dest.data_.get_size() == 0)
+	{
+		dest.sign_ = 1;
+	}
+}
+
+void LN::FuseProduct(LN &dest, const LN &left, const LN &right, bool negative)
+{
+	if (dest.is_nan_ || left.is_nan_ || right.is_nan_)
+	{
+		dest = NaN_;
+		return;
+	}
+	const LN &longer = left.data_.get_size() >= right.data_.get_size() ? left : right;
+	const LN &shorter = &longer == &left ? right : left;
+	size_t ln = longer.data_.get_size();
+	size_t sn = shorter.data_.get_size();
+	if (sn == 0)
+	{
+		return;
+	}
+	int sign = negative ? -left.sign_ * right.sign_ : left.sign_ * right.sign_;
+	size_t dn = dest.data_.get_size();
+
+	if ((dn == 0 || dest.sign_ == sign) && sn < tuning.karatsuba_threshold && &dest != &left && &dest != &right)
+	{
+		// the magnitudes add up, the rows of the schoolbook product go
+		// straight into dest
+		size_t n = std::max(dn, ln + sn) + 1;
+		dest.data_.resize(n);
+		Block *r = dest.data_.get_data();
+		const Block *l = longer.data_.get_data();
+		const Block *s = shorter.data_.get_data();
+		for (size_t j = 0; j < sn; ++j)
+		{
+			Block carry = AddMulBlock(r + j, l, ln, s[j]);
+			for (size_t k = j + ln; carry != 0; ++k)
+			{
+				r[k] += carry;
+				carry = r[k] < carry;
+			}
+		}
+		dest.sign_ = sign;
+		dest.Normalize();
+		return;
+	}
+
+	LN product = Mul(left, right);
+	product.sign_ = sign;
+	dest += product;
+}
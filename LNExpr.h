@@ -0,0 +1,197 @@
+#pragma once
+
+#include "LN.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+
+/*
+ * Lazy sums of LN values. Lazy(x) starts an expression, and +, -, * by a
+ * machine integer and << build it up without computing anything:
+ *
+ *   LN r = (Lazy(a) << 3) + Lazy(b) * 5 - c;
+ *   acc += Lazy(x) * 3 - y;
+ *   acc -= LazyProduct(x, y);
+ *
+ * The value is produced when the expression is converted to LN or added to
+ * one, in a single pass over the limbs that writes each block of the result
+ * once, where the operators of LN write a temporary for every step. An
+ * expression only holds pointers to its operands, so it has to be used in the
+ * full-expression that builds it; keeping one in an auto variable past that
+ * leaves it pointing at destroyed temporaries.
+ */
+
+// |value| * multiplier * 2^shift, subtracted when negative is set
+struct LNTerm
+{
+	const LN *value;
+	uint64_t multiplier;
+	size_t shift;
+	bool negative;
+};
+
+template< size_t N >
+class LNExpr
+{
+  public:
+	std::array< LNTerm, N > terms;
+
+	operator LN() const
+	{
+		LN result;
+		LN::Fuse(result, terms.data(), N);
+		return result;
+	}
+
+	// dest = the value, dest may appear in the expression
+	void Evaluate(LN &dest) const { LN::Fuse(dest, terms.data(), N); }
+};
+
+// left * right, only ever added to or subtracted from a number; a product
+// with a shorter side below the Karatsuba threshold accumulates its rows
+// straight into the destination
+class LNProduct
+{
+  public:
+	const LN *left;
+	const LN *right;
+	bool negative;
+
+	operator LN() const
+	{
+		LN result;
+		AddTo(result);
+		return result;
+	}
+
+	void AddTo(LN &dest) const { LN::FuseProduct(dest, *left, *right, negative); }
+};
+
+inline LNExpr< 1 > Lazy(const LN &value)
+{
+	return { { LNTerm{ &value, 1, 0, false } } };
+}
+
+inline LNProduct LazyProduct(const LN &left, const LN &right)
+{
+	return { &left, &right, false };
+}
+
+template< size_t N, size_t M >
+LNExpr< N + M > operator+(const LNExpr< N > &left, const LNExpr< M > &right)
+{
+	LNExpr< N + M > result;
+	std::copy(left.terms.begin(), left.terms.end(), result.terms.begin());
+	std::copy(right.terms.begin(), right.terms.end(), result.terms.begin() + N);
+	return result;
+}
+
+template< size_t N >
+LNExpr< N > operator-(const LNExpr< N > &expr)
+{
+	LNExpr< N > result = expr;
+	for (LNTerm &term : result.terms)
+	{
+		term.negative = !term.negative;
+	}
+	return result;
+}
+
+template< size_t N, size_t M >
+LNExpr< N + M > operator-(const LNExpr< N > &left, const LNExpr< M > &right)
+{
+	return left + -right;
+}
+
+template< size_t N >
+LNExpr< N + 1 > operator+(const LNExpr< N > &left, const LN &right)
+{
+	return left + Lazy(right);
+}
+
+template< size_t N >
+LNExpr< N + 1 > operator+(const LN &left, const LNExpr< N > &right)
+{
+	return Lazy(left) + right;
+}
+
+template< size_t N >
+LNExpr< N + 1 > operator-(const LNExpr< N > &left, const LN &right)
+{
+	return left - Lazy(right);
+}
+
+template< size_t N >
+LNExpr< N + 1 > operator-(const LN &left, const LNExpr< N > &right)
+{
+	return Lazy(left) - right;
+}
+
+// the multipliers of the terms must stay below 2^64, std::overflow_error
+// otherwise
+template< size_t N >
+LNExpr< N > operator*(const LNExpr< N > &expr, long long factor)
+{
+	uint64_t magnitude = factor < 0 ? 0 - static_cast< uint64_t >(factor) : static_cast< uint64_t >(factor);
+	LNExpr< N > result = expr;
+	for (LNTerm &term : result.terms)
+	{
+		if (magnitude != 0 && term.multiplier > UINT64_MAX / magnitude)
+		{
+			throw std::overflow_error("Multiplier of a lazy term overflows");
+		}
+		term.multiplier *= magnitude;
+		term.negative = term.negative != (factor < 0);
+	}
+	return result;
+}
+
+template< size_t N >
+LNExpr< N > operator*(long long factor, const LNExpr< N > &expr)
+{
+	return expr * factor;
+}
+
+template< size_t N >
+LNExpr< N > operator<<(const LNExpr< N > &expr, size_t bits)
+{
+	LNExpr< N > result = expr;
+	for (LNTerm &term : result.terms)
+	{
+		term.shift += bits;
+	}
+	return result;
+}
+
+template< size_t N >
+LN &operator+=(LN &dest, const LNExpr< N > &expr)
+{
+	(Lazy(dest) + expr).Evaluate(dest);
+	return dest;
+}
+
+template< size_t N >
+LN &operator-=(LN &dest, const LNExpr< N > &expr)
+{
+	(Lazy(dest) - expr).Evaluate(dest);
+	return dest;
+}
+
+inline LNProduct operator-(const LNProduct &product)
+{
+	return { product.left, product.right, !product.negative };
+}
+
+inline LN &operator+=(LN &dest, const LNProduct &product)
+{
+	product.AddTo(dest);
+	return dest;
+}
+
+inline LN &operator-=(LN &dest, const LNProduct &product)
+{
+	(-product).AddTo(dest);
+	return dest;
+}
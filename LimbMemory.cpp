@@ -0,0 +1,159 @@
+#include "LimbMemory.h"
+
+#include "MyDumbVector.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <new>
+
+ResourceScope::ResourceScope(std::pmr::memory_resource *resource) : previous_(dumb_vector_resource())
+{
+	dumb_vector_resource() = resource;
+}
+
+ResourceScope::~ResourceScope()
+{
+	dumb_vector_resource() = previous_;
+}
+
+BumpArena::BumpArena(size_t chunk_size, std::pmr::memory_resource *upstream) :
+	chunk_size_(chunk_size), upstream_(upstream)
+{
+}
+
+BumpArena::~BumpArena()
+{
+	while (first_ != nullptr)
+	{
+		Chunk *next = first_->next;
+		upstream_->deallocate(first_, first_->size, alignof(std::max_align_t));
+		first_ = next;
+	}
+}
+
+void BumpArena::Reset()
+{
+	current_ = nullptr;
+	top_ = nullptr;
+	end_ = nullptr;
+}
+
+void BumpArena::NextChunk(size_t bytes)
+{
+	Chunk *next = current_ == nullptr ? first_ : current_->next;
+	if (next == nullptr || next->size - sizeof(Chunk) < bytes)
+	{
+		// a new chunk goes before the next one, which stays for later
+		size_t size = std::max(chunk_size_, bytes + sizeof(Chunk));
+		Chunk *chunk = new (upstream_->allocate(size, alignof(std::max_align_t))) Chunk{ next, size };
+		if (current_ == nullptr)
+		{
+			first_ = chunk;
+		}
+		else
+		{
+			current_->next = chunk;
+		}
+		next = chunk;
+	}
+	current_ = next;
+	top_ = reinterpret_cast< char * >(next + 1);
+	end_ = reinterpret_cast< char * >(next) + next->size;
+}
+
+void *BumpArena::do_allocate(size_t bytes, size_t alignment)
+{
+	while (true)
+	{
+		size_t pad = (alignment - reinterpret_cast< uintptr_t >(top_) % alignment) % alignment;
+		if (current_ != nullptr && pad + bytes <= static_cast< size_t >(end_ - top_))
+		{
+			char *p = top_ + pad;
+			top_ = p + bytes;
+			return p;
+		}
+		NextChunk(bytes + alignment);
+	}
+}
+
+void BumpArena::do_deallocate(void *p, size_t bytes, size_t)
+{
+	if (static_cast< char * >(p) + bytes == top_)
+	{
+		top_ = static_cast< char * >(p);
+	}
+}
+
+bool BumpArena::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+	return this == &other;
+}
+
+LimbPool::LimbPool(std::pmr::memory_resource *upstream, std::pmr::memory_resource *large_upstream) :
+	upstream_(upstream), large_upstream_(large_upstream)
+{
+}
+
+LimbPool::~LimbPool()
+{
+	while (batches_ != nullptr)
+	{
+		Batch *next = batches_->next;
+		upstream_->deallocate(batches_, batches_->size, alignof(Batch));
+		batches_ = next;
+	}
+}
+
+size_t LimbPool::ClassOf(size_t bytes)
+{
+	size_t bits = std::bit_width(std::max< size_t >(bytes, 1) - 1);
+	return bits <= min_class_bits_ ? 0 : std::min(bits - min_class_bits_, classes_);
+}
+
+void LimbPool::Refill(size_t cls)
+{
+	size_t block = size_t(1) << (cls + min_class_bits_);
+	size_t size = sizeof(Batch) + std::max(batch_bytes_, 4 * block);
+	Batch *batch = new (upstream_->allocate(size, alignof(Batch))) Batch{ batches_, size };
+	batches_ = batch;
+
+	char *first = reinterpret_cast< char * >(batch + 1);
+	char *end = reinterpret_cast< char * >(batch) + size;
+	for (char *p = first; p + block <= end; p += block)
+	{
+		free_[cls] = new (p) FreeBlock{ free_[cls] };
+	}
+}
+
+void *LimbPool::do_allocate(size_t bytes, size_t alignment)
+{
+	size_t cls = ClassOf(bytes);
+	if (cls == classes_ || alignment > alignof(Batch))
+	{
+		return large_upstream_->allocate(bytes, alignment);
+	}
+	if (free_[cls] == nullptr)
+	{
+		Refill(cls);
+	}
+	FreeBlock *block = free_[cls];
+	free_[cls] = block->next;
+	return block;
+}
+
+void LimbPool::do_deallocate(void *p, size_t bytes, size_t alignment)
+{
+	size_t cls = ClassOf(bytes);
+	if (cls == classes_ || alignment > alignof(Batch))
+	{
+		large_upstream_->deallocate(p, bytes, alignment);
+		return;
+	}
+	free_[cls] = new (p) FreeBlock{ free_[cls] };
+}
+
+bool LimbPool::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+	return this == &other;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+/*
+ * Memory resources for the limb buffers of LN. MyDumbVector takes its heap
+ * memory from dumb_vector_resource(), the global heap unless a ResourceScope
+ * on the current thread installs something else. The usual setup for a batch
+ * of short-lived numbers is a LimbPool on top of a BumpArena: freed buffers
+ * are recycled by size class and the arena hands all of it back at once.
+ * None of them is thread-safe, every thread needs its own.
+ */
+
+// makes resource current for the vectors created on this thread while it lives
+class ResourceScope
+{
+  public:
+	explicit ResourceScope(std::pmr::memory_resource *resource);
+	~ResourceScope();
+
+	ResourceScope(const ResourceScope &) = delete;
+	ResourceScope &operator=(const ResourceScope &) = delete;
+
+  private:
+	std::pmr::memory_resource *previous_;
+};
+
+// bump allocation out of large chunks; memory only comes back with Reset,
+// except that the most recent allocation can be freed, which covers
+// temporaries released in stack order
+class BumpArena : public std::pmr::memory_resource
+{
+  public:
+	explicit BumpArena(size_t chunk_size = size_t(1) << 20,
+					   std::pmr::memory_resource *upstream = std::pmr::new_delete_resource());
+	~BumpArena() override;
+
+	BumpArena(const BumpArena &) = delete;
+	BumpArena &operator=(const BumpArena &) = delete;
+
+	// forgets every allocation and keeps the chunks for reuse
+	void Reset();
+
+  private:
+	// header at the start of every chunk
+	struct Chunk
+	{
+		Chunk *next;
+		size_t size;
+	};
+
+	size_t chunk_size_;
+	std::pmr::memory_resource *upstream_;
+	Chunk *first_ = nullptr;
+	Chunk *current_ = nullptr;
+	char *top_ = nullptr;
+	char *end_ = nullptr;
+
+	// moves to the next chunk with room for bytes, allocating one if needed
+	void NextChunk(size_t bytes);
+
+	void *do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+};
+
+// free lists for power-of-two size classes from 64 bytes to 64 KiB, filled in
+// batches from upstream; larger buffers go straight to large_upstream so that
+// they are not held by an arena underneath
+class LimbPool : public std::pmr::memory_resource
+{
+  public:
+	explicit LimbPool(
+		std::pmr::memory_resource *upstream = std::pmr::new_delete_resource(),
+		std::pmr::memory_resource *large_upstream = std::pmr::new_delete_resource());
+	~LimbPool() override;
+
+	LimbPool(const LimbPool &) = delete;
+	LimbPool &operator=(const LimbPool &) = delete;
+
+  private:
+	static constexpr size_t min_class_bits_ = 6;
+	static constexpr size_t max_class_bits_ = 16;
+	static constexpr size_t classes_ = max_class_bits_ - min_class_bits_ + 1;
+	static constexpr size_t batch_bytes_ = size_t(1) << 16;
+
+	struct FreeBlock
+	{
+		FreeBlock *next;
+	};
+	// header at the start of every batch, padded to keep the blocks aligned
+	struct alignas(std::max_align_t) Batch
+	{
+		Batch *next;
+		size_t size;
+	};
+
+	std::pmr::memory_resource *upstream_;
+	std::pmr::memory_resource *large_upstream_;
+	FreeBlock *free_[classes_] = {};
+	Batch *batches_ = nullptr;
+
+	// index of the smallest class holding bytes, classes_ if none does
+	static size_t ClassOf(size_t bytes);
+	void Refill(size_t cls);
+
+	void *do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+};
@@ -2,67 +2,79 @@
 
 #include <algorithm>
 #include <cstring>
+#include <memory_resource>
+#include <type_traits>
 #include <utility>
 
-template< typename T >
+// the resource new MyDumbVectors on this thread take their heap buffers from
+// (see LimbMemory.h); a vector keeps the one it was created with
+inline std::pmr::memory_resource *&dumb_vector_resource()
+{
+	thread_local std::pmr::memory_resource *resource = std::pmr::new_delete_resource();
+	return resource;
+}
+
+// up to N elements are stored inline, larger vectors spill to the heap
+template< typename T, size_t N = 32 / sizeof(T) >
 class MyDumbVector
 {
+	static_assert(N > 0, "the inline buffer needs at least one element");
+	static_assert(std::is_trivially_copyable_v< T >, "elements are moved with memcpy");
+
   public:
-	MyDumbVector() : size_(0), cap_(0), data_(nullptr) {}
+	MyDumbVector() : MyDumbVector(dumb_vector_resource()) {}
 
-	MyDumbVector(const MyDumbVector< T >& other) : size_(other.size_), cap_(other.cap_), data_(new T[cap_]())
+	// for buffers that must outlive the current resource, e.g. caches
+	explicit MyDumbVector(std::pmr::memory_resource* resource) : size_(0), cap_(N), data_(inline_), resource_(resource)
 	{
-		memcpy(data_, other.data_, other.size_ * sizeof(T));
 	}
 
-	MyDumbVector(MyDumbVector< T >&& other) noexcept : MyDumbVector()
+	MyDumbVector(const MyDumbVector< T, N >& other) : MyDumbVector()
 	{
-		std::swap(size_, other.size_);
-		std::swap(cap_, other.cap_);
-		std::swap(data_, other.data_);
+		reserve_discard(other.size_);
+		copy_from(other);
 	}
 
-	MyDumbVector(size_t sz) : size_(sz), cap_(std::max(size_, size_t(1))), data_(new T[cap_]()) {}
+	// takes the resource along with the buffer, so it never allocates
+	MyDumbVector(MyDumbVector< T, N >&& other) noexcept : MyDumbVector(other.resource_) { take(std::move(other)); }
 
-	~MyDumbVector()
+	MyDumbVector(size_t sz) : MyDumbVector()
 	{
-		if (data_)
-		{
-			delete[] data_;
-		}
+		reserve_discard(sz);
+		std::fill(data_, data_ + sz, T());
+		size_ = sz;
 	}
 
-	MyDumbVector< T >& operator=(const MyDumbVector< T >& other)
+	~MyDumbVector() { release(); }
+
+	MyDumbVector< T, N >& operator=(const MyDumbVector< T, N >& other)
 	{
 		if (&other != this)
 		{
-			if (data_)
-			{
-				delete[] data_;
-			}
-			size_ = other.size_;
-			cap_ = other.cap_;
-			data_ = new T[cap_];
-			memcpy(data_, other.data_, size_ * sizeof(T));
+			// the current buffer is kept when it is large enough
+			reserve_discard(other.size_);
+			copy_from(other);
 		}
 		return *this;
 	}
 
-	MyDumbVector< T >& operator=(MyDumbVector< T >&& other) noexcept
+	// a heap buffer is only taken over from a vector with an equal resource,
+	// otherwise the elements are copied like std::pmr containers do; that
+	// copy allocates, so unlike the move constructor this is not noexcept
+	MyDumbVector< T, N >& operator=(MyDumbVector< T, N >&& other)
 	{
 		if (&other != this)
 		{
-			if (data_)
+			if (other.is_inline() || !resource_->is_equal(*other.resource_))
+			{
+				*this = other;
+				other.size_ = 0;
+			}
+			else
 			{
-				delete[] data_;
-				data_ = nullptr;
+				release();
+				take(std::move(other));
 			}
-			size_ = 0;
-			cap_ = 0;
-			data_ = nullptr;
-			std::swap(size_, other.size_);
-			std::swap(cap_, other.cap_);
-			std::swap(data_, other.data_);
 		}
 		return *this;
 	}
@@ -71,59 +83,141 @@ class MyDumbVector
 
 	const T& operator[](size_t i) const { return data_[i]; }
 
+	T* get_data() { return data_; }
+
+	const T* get_data() const { return data_; }
+
 	void push_back(const T& elem)
 	{
-		try_resize();
+		if (size_ == cap_)
+		{
+			reallocate(cap_ * 2);
+		}
 		data_[size_++] = elem;
 	}
 
-	void pop()
+	// never reallocates
+	void pop() { --size_; }
+
+	size_t get_size() const { return size_; }
+
+	size_t get_capacity() const { return cap_; }
+
+	void reserve(size_t new_cap)
 	{
-		try_resize();
-		--size_;
+		if (new_cap > cap_)
+		{
+			reallocate(new_cap);
+		}
 	}
 
-	size_t get_size() const { return size_; }
+	// never shrinks the capacity, new elements are value-initialized
+	void resize(size_t new_size)
+	{
+		size_t old_size = size_;
+		resize_uninitialized(new_size);
+		if (new_size > old_size)
+		{
+			std::fill(data_ + old_size, data_ + new_size, T());
+		}
+	}
+
+	// same as resize, but new elements are left for the caller to write
+	void resize_uninitialized(size_t new_size)
+	{
+		if (new_size > cap_)
+		{
+			reallocate(std::max(new_size, cap_ * 2));
+		}
+		size_ = new_size;
+	}
+
+	// drops the spare capacity, back to the inline buffer if the elements fit
+	void shrink_to_fit()
+	{
+		if (!is_inline() && size_ < cap_)
+		{
+			reallocate(size_);
+		}
+	}
 
   private:
 	size_t size_;
 	size_t cap_;
 	T* data_;
+	std::pmr::memory_resource* resource_;
+	T inline_[N];
 
-	void try_resize()
+	bool is_inline() const { return data_ == inline_; }
+
+	T* allocate(size_t n) { return static_cast< T* >(resource_->allocate(n * sizeof(T), alignof(T))); }
+
+	void release()
 	{
-		size_t new_cap = 0;
-		T* new_data;
+		if (!is_inline())
+		{
+			resource_->deallocate(data_, cap_ * sizeof(T), alignof(T));
+		}
+		data_ = inline_;
+		cap_ = N;
+	}
 
-		if (size_ >= cap_)
+	// room for n elements, the contents are only kept when they already fit
+	void reserve_discard(size_t n)
+	{
+		if (n > cap_)
 		{
-			if (cap_ == 0)
-			{
-				new_cap = 1;
-			}
-			else
-			{
-				new_cap = cap_ * 2;
-			}
+			release();
+			data_ = allocate(n);
+			cap_ = n;
+		}
+	}
+
+	// the buffer must already hold other.size_ elements
+	void copy_from(const MyDumbVector< T, N >& other)
+	{
+		size_ = other.size_;
+		if (size_ != 0)
+		{
+			memcpy(data_, other.data_, size_ * sizeof(T));
 		}
-		else if (cap_ > 8 && size_ <= cap_ / 4)
+	}
+
+	// *this must not own a heap buffer unless other is inline, other is left empty
+	void take(MyDumbVector< T, N >&& other) noexcept
+	{
+		if (other.is_inline())
 		{
-			new_cap = cap_ / 2;
+			copy_from(other);
 		}
 		else
 		{
-			return;
+			data_ = other.data_;
+			cap_ = other.cap_;
+			size_ = other.size_;
+			resource_ = other.resource_;
+			other.data_ = other.inline_;
+			other.cap_ = N;
 		}
+		other.size_ = 0;
+	}
 
-		new_data = new T[new_cap]();
-
-		if (data_ != nullptr)
+	void reallocate(size_t new_cap)
+	{
+		T* new_data = new_cap <= N ? inline_ : allocate(new_cap);
+		if (new_data != data_)
 		{
-			memcpy(new_data, data_, size_ * sizeof(T));
-			delete[] data_;
+			if (size_ != 0)
+			{
+				memcpy(new_data, data_, size_ * sizeof(T));
+			}
+			if (!is_inline())
+			{
+				resource_->deallocate(data_, cap_ * sizeof(T), alignof(T));
+			}
 		}
 
 		data_ = new_data;
-		cap_ = new_cap;
+		cap_ = new_cap <= N ? N : new_cap;
 	}
 };
@@ -0,0 +1,323 @@
+#include "LN.h"
+
+#include <vector>
+
+/*
+ * Multiplication by number-theoretic transforms modulo three primes below 2^31.
+ * The operands are cut into 30-bit chunks, so every coefficient of the cyclic
+ * convolution is below min(na, nb) * 2^60 <= 2^85, less than the product of
+ * the primes (~2^87), and is recovered exactly with Garner's CRT.
+ */
+
+namespace
+{
+	constexpr uint32_t P1 = 2013265921;	   // 15 * 2^27 + 1
+	constexpr uint32_t P2 = 469762049;	   // 7 * 2^26 + 1
+	constexpr uint32_t P3 = 167772161;	   // 5 * 2^25 + 1
+	constexpr size_t max_transform_length = size_t(1) << 25;
+	constexpr size_t chunk_bits = 30;
+	constexpr uint32_t chunk_mask = (1u << chunk_bits) - 1;
+
+	constexpr uint32_t PowMod(uint64_t a, uint64_t e, uint32_t p)
+	{
+		uint64_t result = 1;
+		a %= p;
+		while (e)
+		{
+			if (e & 1)
+			{
+				result = result * a % p;
+			}
+			a = a * a % p;
+			e >>= 1;
+		}
+		return static_cast< uint32_t >(result);
+	}
+
+	constexpr uint32_t InvMod(uint64_t a, uint32_t p)
+	{
+		return PowMod(a, p - 2, p);
+	}
+
+	template< uint32_t P >
+	inline uint32_t MulMod(uint32_t a, uint32_t b)
+	{
+		return static_cast< uint32_t >(static_cast< uint64_t >(a) * b % P);
+	}
+
+	// floor(w * 2^32 / P), lets MulShoup replace the division by a multiplication
+	template< uint32_t P >
+	inline uint32_t ShoupFactor(uint32_t w)
+	{
+		return static_cast< uint32_t >((static_cast< uint64_t >(w) << 32) / P);
+	}
+
+	// a * w mod P for any a < 2^32
+	template< uint32_t P >
+	inline uint32_t MulShoup(uint32_t a, uint32_t w, uint32_t w_shoup)
+	{
+		uint32_t q = static_cast< uint32_t >((static_cast< uint64_t >(a) * w_shoup) >> 32);
+		uint32_t r = a * w - q * P;
+		return r >= P ? r - P : r;
+	}
+
+	template< uint32_t P, uint32_t G >
+	class Transform
+	{
+	  public:
+		// the root tables do not depend on the length, so one per thread is kept
+		// and only ever grown
+		static const Transform &Get(size_t n)
+		{
+			thread_local Transform transform;
+			transform.Grow(n);
+			return transform;
+		}
+
+		// decimation in frequency: natural order in, bit-reversed order out
+		void Forward(uint32_t *a, size_t n) const
+		{
+			for (size_t half = n / 2; half >= 1; half >>= 1)
+			{
+				const uint32_t *w = roots_.data() + half;
+				const uint32_t *ws = roots_shoup_.data() + half;
+				for (size_t i = 0; i < n; i += 2 * half)
+				{
+					for (size_t j = 0; j < half; ++j)
+					{
+						uint32_t u = a[i + j];
+						uint32_t v = a[i + j + half];
+						uint32_t sum = u + v;
+						a[i + j] = sum >= P ? sum - P : sum;
+						a[i + j + half] = MulShoup< P >(u + P - v, w[j], ws[j]);
+					}
+				}
+			}
+		}
+
+		// decimation in time: bit-reversed order in, natural order out, without
+		// the 1 / n scaling (it is folded into the pointwise products)
+		void Inverse(uint32_t *a, size_t n) const
+		{
+			for (size_t half = 1; half < n; half <<= 1)
+			{
+				const uint32_t *w = iroots_.data() + half;
+				const uint32_t *ws = iroots_shoup_.data() + half;
+				for (size_t i = 0; i < n; i += 2 * half)
+				{
+					for (size_t j = 0; j < half; ++j)
+					{
+						uint32_t u = a[i + j];
+						uint32_t v = MulShoup< P >(a[i + j + half], w[j], ws[j]);
+						uint32_t sum = u + v;
+						a[i + j] = sum >= P ? sum - P : sum;
+						a[i + j + half] = u >= v ? u - v : u + P - v;
+					}
+				}
+			}
+		}
+
+	  private:
+		size_t n_ = 1;
+		std::vector< uint32_t > roots_;
+		std::vector< uint32_t > roots_shoup_;
+		std::vector< uint32_t > iroots_;
+		std::vector< uint32_t > iroots_shoup_;
+
+		// roots_[len / 2 + j] = w_len^j for every power of two len <= n
+		void Grow(size_t n)
+		{
+			if (n <= n_)
+			{
+				return;
+			}
+			roots_.resize(n);
+			roots_shoup_.resize(n);
+			iroots_.resize(n);
+			iroots_shoup_.resize(n);
+			for (size_t half = n_; half < n; half <<= 1)
+			{
+				uint32_t w = PowMod(G, (P - 1) / (2 * half), P);
+				uint32_t iw = InvMod(w, P);
+				uint32_t r = 1;
+				uint32_t ir = 1;
+				for (size_t j = 0; j < half; ++j)
+				{
+					roots_[half + j] = r;
+					roots_shoup_[half + j] = ShoupFactor< P >(r);
+					iroots_[half + j] = ir;
+					iroots_shoup_[half + j] = ShoupFactor< P >(ir);
+					r = MulMod< P >(r, w);
+					ir = MulMod< P >(ir, iw);
+				}
+			}
+			n_ = n;
+		}
+	};
+
+	// cyclic convolution of a and b (or a with itself) modulo P, length n
+	template< uint32_t P, uint32_t G >
+	std::vector< uint32_t > Convolve(const std::vector< uint32_t > &a, const std::vector< uint32_t > *b, size_t n)
+	{
+		const Transform< P, G > &transform = Transform< P, G >::Get(n);
+		uint32_t inv_n = InvMod(n, P);
+		uint32_t inv_n_shoup = ShoupFactor< P >(inv_n);
+
+		// the chunks are below 2^30, so reducing them once is enough
+		std::vector< uint32_t > fa(n);
+		for (size_t i = 0; i < a.size(); ++i)
+		{
+			fa[i] = a[i] % P;
+		}
+		transform.Forward(fa.data(), n);
+		if (b == nullptr)
+		{
+			for (size_t i = 0; i < n; ++i)
+			{
+				fa[i] = MulShoup< P >(MulMod< P >(fa[i], fa[i]), inv_n, inv_n_shoup);
+			}
+		}
+		else
+		{
+			std::vector< uint32_t > fb(n);
+			for (size_t i = 0; i < b->size(); ++i)
+			{
+				fb[i] = (*b)[i] % P;
+			}
+			transform.Forward(fb.data(), n);
+			for (size_t i = 0; i < n; ++i)
+			{
+				fa[i] = MulShoup< P >(MulMod< P >(fa[i], fb[i]), inv_n, inv_n_shoup);
+			}
+		}
+		transform.Inverse(fa.data(), n);
+		return fa;
+	}
+
+	// unsigned 128-bit accumulator for the carry propagation, kept portable
+	// because the 32-bit block build may not have __int128
+	struct Accumulator
+	{
+		uint64_t lo = 0;
+		uint64_t hi = 0;
+
+		void Add(uint64_t x)
+		{
+			lo += x;
+			hi += lo < x;
+		}
+
+		void AddHigh(uint64_t x)	// += x * 2^32
+		{
+			Add(x << 32);
+			hi += x >> 32;
+		}
+
+		uint32_t PopChunk()
+		{
+			uint32_t chunk = static_cast< uint32_t >(lo & chunk_mask);
+			lo = (lo >> chunk_bits) | (hi << (64 - chunk_bits));
+			hi >>= chunk_bits;
+			return chunk;
+		}
+
+		bool IsZero() const { return lo == 0 && hi == 0; }
+	};
+}	 // namespace
+
+bool LN::NttFits(size_t n1, size_t n2)
+{
+	return ((n1 + n2) * bits_in_block_ + chunk_bits - 1) / chunk_bits <= max_transform_length;
+}
+
+LN LN::NttMul(const LN &num1, const LN &num2)
+{
+	bool square = &num1 == &num2;
+
+	auto to_chunks = [](const LN &num)
+	{
+		size_t n = num.data_.get_size();
+		std::vector< uint32_t > chunks((n * bits_in_block_ + chunk_bits - 1) / chunk_bits);
+		for (size_t i = 0; i < chunks.size(); ++i)
+		{
+			size_t bit = i * chunk_bits;
+			DoubleBlock pair = static_cast< DoubleBlock >(num.get_block(bit / bits_in_block_ + 1)) << bits_in_block_ |
+							   num.data_[bit / bits_in_block_];
+			chunks[i] = static_cast< uint32_t >(pair >> (bit % bits_in_block_)) & chunk_mask;
+		}
+		while (!chunks.empty() && chunks.back() == 0)
+		{
+			chunks.pop_back();
+		}
+		return chunks;
+	};
+
+	std::vector< uint32_t > a = to_chunks(num1);
+	std::vector< uint32_t > b = square ? std::vector< uint32_t >() : to_chunks(num2);
+	size_t na = a.size();
+	size_t nb = square ? na : b.size();
+	if (na == 0 || nb == 0)
+	{
+		return { 0LL };
+	}
+
+	size_t n = std::bit_ceil(na + nb - 1);
+	const std::vector< uint32_t > *other = square ? nullptr : &b;
+	// one convolution per prime, independent of each other
+	std::vector< uint32_t > r1;
+	std::vector< uint32_t > r2;
+	std::vector< uint32_t > r3;
+	Fork(
+		num2.data_.get_size(),
+		3,
+		[&](size_t i)
+		{
+			if (i == 0)
+			{
+				r1 = Convolve< P1, 31 >(a, other, n);
+			}
+			else if (i == 1)
+			{
+				r2 = Convolve< P2, 3 >(a, other, n);
+			}
+			else
+			{
+				r3 = Convolve< P3, 3 >(a, other, n);
+			}
+		});
+
+	// Garner: x = v1 + P1 * v2 + P1 * P2 * v3
+	constexpr uint32_t inv_p1_mod_p2 = InvMod(P1, P2);
+	constexpr uint32_t inv_p1p2_mod_p3 = InvMod(static_cast< uint64_t >(P1) * P2 % P3, P3);
+	constexpr uint32_t p1_mod_p3 = P1 % P3;
+	constexpr uint64_t p1p2 = static_cast< uint64_t >(P1) * P2;
+
+	size_t result_chunks = na + nb;
+	LN result;
+	result.data_.resize((result_chunks * chunk_bits + bits_in_block_ - 1) / bits_in_block_ + 1);
+	Block *res = result.data_.get_data();
+
+	Accumulator acc;
+	for (size_t i = 0; i < result_chunks; ++i)
+	{
+		if (i < na + nb - 1)
+		{
+			uint32_t v1 = r1[i];
+			uint32_t v2 = MulMod< P2 >(r2[i] + P2 - v1 % P2, inv_p1_mod_p2);
+			uint32_t x12_mod_p3 = static_cast< uint32_t >((v1 + static_cast< uint64_t >(p1_mod_p3) * v2) % P3);
+			uint32_t v3 = MulMod< P3 >(r3[i] + P3 - x12_mod_p3, inv_p1p2_mod_p3);
+
+			acc.Add(v1 + static_cast< uint64_t >(P1) * v2);
+			acc.Add((p1p2 & 0xffffffff) * v3);
+			acc.AddHigh((p1p2 >> 32) * v3);
+		}
+		size_t bit = i * chunk_bits;
+		DoubleBlock chunk = static_cast< DoubleBlock >(acc.PopChunk()) << (bit % bits_in_block_);
+		res[bit / bits_in_block_] |= static_cast< Block >(chunk);
+		res[bit / bits_in_block_ + 1] |= static_cast< Block >(chunk >> bits_in_block_);
+	}
+	assert(acc.IsZero());
+
+	result.Normalize();
+	return result;
+}
@@ -0,0 +1,134 @@
+#include "OutputWriter.h"
+
+OutputWriter::OutputWriter(std::ostream &out, bool background, size_t buffer_size) :
+	out_(out), background_(background), buffer_size_(buffer_size), current_(buffer_size)
+{
+}
+
+OutputWriter::~OutputWriter()
+{
+	Flush();
+	if (thread_.joinable())
+	{
+		{
+			std::lock_guard< std::mutex > lock(mutex_);
+			stop_ = true;
+		}
+		cv_.notify_all();
+		thread_.join();
+	}
+}
+
+char *OutputWriter::Reserve(size_t size)
+{
+	if (current_.size() - used_ < size)
+	{
+		if (used_ != 0)
+		{
+			Hand();
+		}
+		if (current_.size() < size)
+		{
+			current_.resize(size);
+		}
+	}
+	return current_.data() + used_;
+}
+
+void OutputWriter::Commit(char *end)
+{
+	used_ = end - current_.data();
+}
+
+void OutputWriter::Write(std::string_view bytes)
+{
+	char *p = Reserve(bytes.size());
+	Commit(std::copy(bytes.begin(), bytes.end(), p));
+}
+
+void OutputWriter::WriteLine(const LN &value, unsigned base)
+{
+	if (base != 16)
+	{
+		std::string text = value.ToString(base);
+		char *p = Reserve(text.size() + 1);
+		p = std::copy(text.begin(), text.end(), p);
+		*p++ = '\n';
+		Commit(p);
+		return;
+	}
+	char *p = value.WriteTo(Reserve(value.StringLength() + 1));
+	*p++ = '\n';
+	Commit(p);
+}
+
+bool OutputWriter::Flush()
+{
+	if (used_ != 0)
+	{
+		// only a full buffer starts the thread, what never filled one is
+		// written here
+		if (thread_.joinable())
+		{
+			Hand();
+		}
+		else
+		{
+			out_.write(current_.data(), static_cast< std::streamsize >(used_));
+			used_ = 0;
+		}
+	}
+	if (thread_.joinable())
+	{
+		std::unique_lock< std::mutex > lock(mutex_);
+		cv_.wait(lock, [this] { return !has_pending_; });
+	}
+	out_.flush();
+	return !out_.fail();
+}
+
+void OutputWriter::Hand()
+{
+	if (!background_)
+	{
+		out_.write(current_.data(), static_cast< std::streamsize >(used_));
+		used_ = 0;
+		return;
+	}
+	if (!thread_.joinable())
+	{
+		thread_ = std::thread(&OutputWriter::Run, this);
+	}
+	{
+		std::unique_lock< std::mutex > lock(mutex_);
+		cv_.wait(lock, [this] { return !has_pending_; });
+		pending_.swap(current_);
+		pending_size_ = used_;
+		has_pending_ = true;
+	}
+	cv_.notify_all();
+	used_ = 0;
+	// the first swap brings back the empty pending_
+	if (current_.size() < buffer_size_)
+	{
+		current_.resize(buffer_size_);
+	}
+}
+
+void OutputWriter::Run()
+{
+	std::unique_lock< std::mutex > lock(mutex_);
+	while (true)
+	{
+		cv_.wait(lock, [this] { return has_pending_ || stop_; });
+		if (!has_pending_)
+		{
+			return;
+		}
+		lock.unlock();
+		out_.write(pending_.data(), static_cast< std::streamsize >(pending_size_));
+		lock.lock();
+		has_pending_ = false;
+		cv_.notify_all();
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "LN.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Output collected in a large buffer and written with one call per buffer.
+// Values are serialized straight into the buffer; a value longer than the
+// buffer grows it instead of being split. With background set, full buffers
+// are written by a second thread while the next one fills. Only Reserve
+// starts the thread, when it hands off a full buffer; output that never
+// fills one is written by Flush on the calling thread.
+class OutputWriter
+{
+  public:
+	explicit OutputWriter(std::ostream &out, bool background = true, size_t buffer_size = size_t(1) << 20);
+	// flushes, errors are lost; call Flush to see them
+	~OutputWriter();
+
+	OutputWriter(const OutputWriter &) = delete;
+	OutputWriter &operator=(const OutputWriter &) = delete;
+
+	// room for size bytes; the bytes count once Commit gets their end
+	char *Reserve(size_t size);
+	void Commit(char *end);
+
+	void Write(std::string_view bytes);
+	// value in base, then '\n'
+	void WriteLine(const LN &value, unsigned base = 16);
+
+	// writes everything so far and waits for it, false if the stream failed
+	bool Flush();
+
+  private:
+	std::ostream &out_;
+	bool background_;
+	size_t buffer_size_;
+	std::vector< char > current_;
+	size_t used_ = 0;
+
+	// the background thread and the buffer it is writing
+	std::thread thread_;
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	std::vector< char > pending_;
+	size_t pending_size_ = 0;
+	bool has_pending_ = false;
+	bool stop_ = false;
+
+	// passes current_[0, used_) on and leaves an empty current_
+	void Hand();
+	void Run();
+};
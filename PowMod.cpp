@@ -0,0 +1,256 @@
+#include "PowMod.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace
+{
+	// width of the windows for an exponent of bits bits: the 2^(w - 1) odd
+	// powers in the table have to pay for the multiplications wider windows
+	// save
+	size_t WindowFor(size_t bits)
+	{
+		constexpr size_t limits[] = { 23, 79, 239, 671, 1791 };
+		size_t w = 1;
+		for (size_t limit : limits)
+		{
+			w += bits > limit;
+		}
+		return w;
+	}
+}	 // namespace
+
+ModContext::ModContext(const LN &mod) : mod_(mod)
+{
+	mod_.sign_ = 1;
+	n_ = mod_.data_.get_size();
+	valid_ = !mod_.is_nan_ && n_ != 0;
+	if (!valid_)
+	{
+		return;
+	}
+	// 2^k leaves the low k bits; it is also the only even mod whose mu may
+	// not fit n_ + 1 blocks, 2^(bits_in_block_ (n_ - 1)) has mu = R * 2^bits_in_block_
+	power_of_two_ = std::has_single_bit(mod_.data_[n_ - 1]) &&
+					std::all_of(mod_.data_.get_data(), mod_.data_.get_data() + n_ - 1, [](Block b) { return b == 0; });
+	if (power_of_two_)
+	{
+		return;
+	}
+	montgomery_ = (mod_.data_[0] & 1) != 0;
+
+	LN r2(1LL);
+	r2.ShiftLeft(2 * n_ * LN::bits_in_block_);
+	if (montgomery_)
+	{
+		// inverse of mod modulo 2^bits_in_block_ as in LN::DivExact
+		Block m0 = mod_.data_[0];
+		Block inverse = m0;
+		for (int i = 0; i < 5; ++i)
+		{
+			inverse *= 2 - m0 * inverse;
+		}
+		inverse_ = 0 - inverse;
+		LN::Div(nullptr, &r2_, r2, mod_);
+	}
+	else
+	{
+		// an even mod that is not a power of two is above 2^(bits_in_block_ (n_ - 1)),
+		// so mu is below 2^(bits_in_block_ (n_ + 1)) and fits n_ + 1 blocks
+		LN mu;
+		LN::Div(&mu, nullptr, r2, mod_);
+		mu_ = mu.data_;
+		mu_.resize(n_ + 1);
+	}
+}
+
+const LN &ModContext::Modulus() const
+{
+	return mod_;
+}
+
+size_t ModContext::WorkSize() const
+{
+	// the product, two Barrett products and the Karatsuba scratch
+	return 3 * (2 * n_ + 2) + std::max(LN::KaraScratchSize(n_ + 1, LN::tuning.karatsuba_threshold),
+									   LN::KaraScratchSize(n_, LN::tuning.karatsuba_sqr_threshold));
+}
+
+void ModContext::MulMod(Block *r, const Block *a, const Block *b, Block *work) const
+{
+	size_t n = n_;
+	const Block *m = mod_.data_.get_data();
+	Block *t = work;
+	Block *q = t + 2 * n + 2;
+	Block *p = q + 2 * n + 2;
+	Block *scratch = p + 2 * n + 2;
+	if (a == b)
+	{
+		LN::SqrBlocks(t, a, n, scratch);
+	}
+	else
+	{
+		LN::MulBlocks(t, a, n, b, n, scratch);
+	}
+
+	if (montgomery_)
+	{
+		// adding multiples of mod clears the low blocks one at a time, what
+		// is left above them is t / R < 2 mod
+		t[2 * n] = 0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			Block carry = LN::AddMulBlock(t + i, m, n, t[i] * inverse_);
+			for (size_t k = i + n; carry != 0; ++k)
+			{
+				t[k] += carry;
+				carry = t[k] < carry;
+			}
+		}
+		Block *high = t + n;
+		if (high[n] != 0 || LN::CompareBlocks(high, n, m, n) >= 0)
+		{
+			LN::SubBlocks(r, high, n, m, n);
+		}
+		else
+		{
+			std::copy_n(high, n, r);
+		}
+		return;
+	}
+	if (power_of_two_)
+	{
+		std::copy_n(t, n, r);
+		r[n - 1] &= m[n - 1] - 1;
+		return;
+	}
+
+	// q estimates t / mod from the top n + 1 blocks of t and mu, and is at
+	// most 2 short, so the remainder fits the low n + 1 blocks
+	LN::MulBlocks(q, t + n - 1, n + 1, mu_.get_data(), n + 1, scratch);
+	LN::MulBlocks(p, q + n + 1, n + 1, m, n, scratch);
+	LN::SubBlocks(t, t, n + 1, p, n + 1);
+	while (LN::CompareBlocks(t, n + 1, m, n) >= 0)
+	{
+		LN::SubBlocks(t, t, n + 1, m, n);
+	}
+	std::copy_n(t, n, r);
+}
+
+LN LN::PowMod(const LN &base, const LN &exp, const LN &mod)
+{
+	return PowMod(base, exp, ModContext(mod));
+}
+
+/*
+ * Left-to-right sliding windows: every window of up to w bits of exp starts
+ * and ends with a 1, so it is an odd number and its power comes from a table
+ * of the odd powers of base. The zero bits between windows cost a squaring
+ * each, a window costs one squaring per bit and one product.
+ */
+LN LN::PowMod(const LN &base, const LN &exp, const ModContext &context)
+{
+	if (!context.valid_ || base.is_nan_ || exp.is_nan_ || exp.sign_ == -1)
+	{
+		return NaN_;
+	}
+	const LN &mod = context.mod_;
+	size_t n = context.n_;
+	if (n == 1 && mod.data_[0] == 1)
+	{
+		return { 0LL };
+	}
+	size_t bits = exp.BitLength();
+	if (bits == 0)
+	{
+		return { 1LL };
+	}
+
+	// base in [0, mod)
+	LN b;
+	Div(nullptr, &b, base, mod);
+	if (base.sign_ == -1 && b.data_.get_size() != 0)
+	{
+		b = mod - b;
+	}
+	if (b.data_.get_size() == 0)
+	{
+		return { 0LL };
+	}
+
+	size_t w = WindowFor(bits);
+	size_t odd = size_t(1) << (w - 1);
+	MyDumbVector< Block > buffers(n * (odd + 2) + context.WorkSize());
+	Block *table = buffers.get_data();
+	Block *acc = table + odd * n;
+	Block *other = acc + n;
+	Block *work = other + n;
+
+	// table[i] = base^(2i + 1), in Montgomery form base R comes from R^2
+	std::copy_n(b.data_.get_data(), b.data_.get_size(), table);
+	if (context.montgomery_)
+	{
+		std::copy_n(context.r2_.data_.get_data(), context.r2_.data_.get_size(), other);
+		context.MulMod(table, table, other, work);
+	}
+	if (odd > 1)
+	{
+		context.MulMod(other, table, table, work);
+		for (size_t i = 1; i < odd; ++i)
+		{
+			context.MulMod(table + i * n, table + (i - 1) * n, other, work);
+		}
+	}
+
+	auto bit = [&exp](size_t i) { return exp.data_[i / bits_in_block_] >> (i % bits_in_block_) & 1; };
+	// bits [i, bits) are done
+	size_t i = bits;
+	bool started = false;
+	while (i > 0)
+	{
+		if (!bit(i - 1))
+		{
+			context.MulMod(acc, acc, acc, work);
+			--i;
+			continue;
+		}
+		size_t low = i > w ? i - w : 0;
+		while (!bit(low))
+		{
+			++low;
+		}
+		size_t value = 0;
+		for (size_t k = i; k-- > low;)
+		{
+			value = value << 1 | bit(k);
+		}
+		const Block *power = table + (value - 1) / 2 * n;
+		if (!started)
+		{
+			std::copy_n(power, n, acc);
+			started = true;
+		}
+		else
+		{
+			for (size_t k = low; k < i; ++k)
+			{
+				context.MulMod(acc, acc, acc, work);
+			}
+			context.MulMod(acc, acc, power, work);
+		}
+		i = low;
+	}
+
+	if (context.montgomery_)
+	{
+		// out of Montgomery form: a product with 1 divides by R
+		std::fill(other, other + n, 0);
+		other[0] = 1;
+		context.MulMod(acc, acc, other, work);
+	}
+	LN result;
+	result.data_.resize_uninitialized(n);
+	std::copy_n(acc, n, result.data_.get_data());
+	result.Normalize();
+	return result;
+}
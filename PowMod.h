@@ -0,0 +1,44 @@
+#pragma once
+
+#include "LN.h"
+
+/*
+ * What LN::PowMod precomputes for one modulus, to be reused across
+ * exponentiations with it. An odd modulus works in Montgomery form with
+ * R = 2^(n * bits of a block) for its n blocks, a power of two keeps the low
+ * bits of a product, and any other one uses Barrett reduction with
+ * mu = floor(R^2 / mod). Either way a modular product is one
+ * multiplication of n-block spans and a reduction without division, on
+ * buffers allocated once per exponentiation.
+ */
+class ModContext
+{
+  public:
+	// works with |mod|; a context for a NaN or zero modulus gives NaN
+	explicit ModContext(const LN &mod);
+
+	const LN &Modulus() const;
+
+  private:
+	friend class LN;
+	using Block = LN::Block;
+
+	LN mod_;
+	size_t n_ = 0;
+	bool valid_ = false;
+	bool montgomery_ = false;
+	// mod is 2^k, a product is reduced by masking it
+	bool power_of_two_ = false;
+	// -mod^-1 modulo 2^bits_in_block_ (Montgomery)
+	Block inverse_ = 0;
+	// R^2 mod mod, which takes numbers into Montgomery form
+	LN r2_;
+	// floor(R^2 / mod) padded to n_ + 1 blocks (Barrett)
+	MyDumbVector< Block > mu_;
+
+	// blocks MulMod needs in work
+	size_t WorkSize() const;
+	// r[0, n_) = a * b mod mod_ for a, b < mod_ of n_ blocks, divided by R
+	// in Montgomery form; r may be a or b
+	void MulMod(Block *r, const Block *a, const Block *b, Block *work) const;
+};
@@ -0,0 +1,296 @@
+#include "Digits.h"
+#include "LN.h"
+#include "LNExpr.h"
+#include "LimbMemory.h"
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Conversion to and from bases other than 16. The digits are grouped into
+ * chunks, as many as fit a block, so a chunk is one block-sized digit in base
+ * big = base^chunk_digits. Runs of leaf_chunks chunks are converted with
+ * schoolbook multiply-add or division by big. Above that the conversion is
+ * divide-and-conquer over the powers big^(leaf_chunks * 2^level): parsing
+ * joins neighbouring halves with one multiplication, printing splits a number
+ * into halves with one division. Both are then about M(n) log n instead of
+ * quadratic. The powers are cached per base for the life of the program.
+ */
+
+namespace
+{
+	constexpr size_t leaf_chunks = 32;
+
+	template< typename Block >
+	struct Chunk
+	{
+		size_t digits;
+		Block big;
+	};
+
+	// the most digits of base that fit a block, and base to that power
+	template< typename Block >
+	Chunk< Block > ChunkOf(unsigned base)
+	{
+		Chunk< Block > chunk{ 1, base };
+		while (chunk.big <= std::numeric_limits< Block >::max() / base)
+		{
+			chunk.big *= base;
+			++chunk.digits;
+		}
+		return chunk;
+	}
+
+	// r[0, n) = r * m + add, returns the new length
+	template< typename Block, typename DoubleBlock >
+	size_t MulAddSmall(Block *r, size_t n, Block m, Block add)
+	{
+		Block carry = add;
+		for (size_t i = 0; i < n; ++i)
+		{
+			DoubleBlock t = static_cast< DoubleBlock >(r[i]) * m + carry;
+			r[i] = static_cast< Block >(t);
+			carry = static_cast< Block >(t >> (sizeof(Block) * 8));
+		}
+		if (carry != 0)
+		{
+			r[n++] = carry;
+		}
+		return n;
+	}
+
+	// r[0, n) /= d, returns the remainder and drops the top block once it is 0
+	template< typename Block, typename DoubleBlock >
+	Block DivSmall(Block *r, size_t &n, Block d)
+	{
+		DoubleBlock rem = 0;
+		for (size_t i = n; i-- > 0;)
+		{
+			DoubleBlock cur = rem << (sizeof(Block) * 8) | r[i];
+			r[i] = static_cast< Block >(cur / d);
+			rem = cur % d;
+		}
+		if (n != 0 && r[n - 1] == 0)
+		{
+			--n;
+		}
+		return static_cast< Block >(rem);
+	}
+
+	// the digits of value padded with zeros to width, or without leading zeros
+	// for width 0
+	template< typename Block >
+	char *WriteChunk(Block value, unsigned base, size_t width, char *out)
+	{
+		char digits[64];
+		size_t count = 0;
+		while (value != 0 || count < width)
+		{
+			digits[count++] = digit_chars[value % base];
+			value /= base;
+		}
+		return std::reverse_copy(digits, digits + count, out);
+	}
+
+	void CheckBase(unsigned base)
+	{
+		if (base < 2 || base > 36)
+		{
+			throw std::domain_error("Base must be from 2 to 36");
+		}
+	}
+}	 // namespace
+
+const LN &LN::RadixPower(unsigned base, size_t level)
+{
+	// deque elements stay in place while more levels are appended
+	static std::mutex mutex;
+	static std::array< std::deque< LN >, 37 > powers;
+
+	std::lock_guard< std::mutex > lock(mutex);
+	std::deque< LN > &cached = powers[base];
+	if (level < cached.size())
+	{
+		return cached[level];
+	}
+	// the cache outlives whatever resource the caller has installed
+	ResourceScope global(std::pmr::new_delete_resource());
+	if (cached.empty())
+	{
+		Block big = ChunkOf< Block >(base).big;
+		LN power(1LL);
+		for (size_t i = 0; i < leaf_chunks; ++i)
+		{
+			power = SingleMul(power, big);
+		}
+		cached.push_back(std::move(power));
+	}
+	while (cached.size() <= level)
+	{
+		cached.push_back(Sqr(cached.back()));
+	}
+	return cached[level];
+}
+
+LN LN::FromString(std::string_view text, unsigned base)
+{
+	CheckBase(base);
+	if (base == 16)
+	{
+		return LN(text);
+	}
+
+	LN result;
+	if (text.empty())
+	{
+		return result;
+	}
+	const char *begin = text.data();
+	const char *end = begin + text.size();
+	if (*begin == '-')
+	{
+		result.sign_ = -1;
+		++begin;
+	}
+	if (begin == end)
+	{
+		return NaN_;
+	}
+
+	// chunks, least significant first; the top one may be shorter
+	Chunk< Block > chunk = ChunkOf< Block >(base);
+	size_t digits = end - begin;
+	size_t chunks = (digits + chunk.digits - 1) / chunk.digits;
+	MyDumbVector< Block > values;
+	values.resize_uninitialized(chunks);
+	uint8_t bad = 0;
+	for (size_t i = 0; i < chunks; ++i)
+	{
+		const char *to = end - i * chunk.digits;
+		const char *from = i + 1 == chunks ? begin : to - chunk.digits;
+		Block value = 0;
+		for (const char *p = from; p < to; ++p)
+		{
+			uint8_t v = digit_value[static_cast< unsigned char >(*p)];
+			bad |= v >= base;
+			value = value * base + v;
+		}
+		values[i] = value;
+	}
+	if (bad)
+	{
+		return NaN_;
+	}
+
+	// leaves of leaf_chunks chunks by Horner's rule
+	std::vector< LN > parts((chunks + leaf_chunks - 1) / leaf_chunks);
+	for (size_t j = 0; j < parts.size(); ++j)
+	{
+		size_t from = j * leaf_chunks;
+		size_t to = std::min(from + leaf_chunks, chunks);
+		MyDumbVector< Block > &data = parts[j].data_;
+		data.resize_uninitialized(to - from);
+		size_t n = 0;
+		for (size_t i = to; i-- > from;)
+		{
+			n = MulAddSmall< Block, DoubleBlock >(data.get_data(), n, chunk.big, values[i]);
+		}
+		data.resize(n);
+	}
+
+	// every pass joins pairs, all but the last part being full
+	for (size_t level = 0; parts.size() > 1; ++level)
+	{
+		const LN &power = RadixPower(base, level);
+		size_t joined = 0;
+		for (size_t j = 0; j < parts.size(); j += 2)
+		{
+			if (j + 1 == parts.size())
+			{
+				parts[joined++] = std::move(parts[j]);
+				break;
+			}
+			parts[j] += LazyProduct(parts[j + 1], power);
+			parts[joined++] = std::move(parts[j]);
+		}
+		parts.resize(joined);
+	}
+
+	result.data_ = std::move(parts[0].data_);
+	if (result.data_.get_size() == 0)
+	{
+		result.sign_ = 1;
+	}
+	return result;
+}
+
+char *LN::WriteRadix(const LN &num, unsigned base, size_t level, char *out, bool pad)
+{
+	Chunk< Block > chunk = ChunkOf< Block >(base);
+	if (level == 0)
+	{
+		// num < big^leaf_chunks, its chunks come off the bottom
+		Block blocks[leaf_chunks];
+		size_t n = num.data_.get_size();
+		std::copy_n(num.data_.get_data(), n, blocks);
+		Block values[leaf_chunks];
+		size_t count = 0;
+		while (count < (pad ? leaf_chunks : 1) || n != 0)
+		{
+			values[count++] = DivSmall< Block, DoubleBlock >(blocks, n, chunk.big);
+		}
+		out = WriteChunk(values[count - 1], base, pad ? chunk.digits : 0, out);
+		for (size_t i = count - 1; i-- > 0;)
+		{
+			out = WriteChunk(values[i], base, chunk.digits, out);
+		}
+		return out;
+	}
+
+	const LN &power = RadixPower(base, level - 1);
+	if (!pad && num.abs_compare(power) == std::strong_ordering::less)
+	{
+		return WriteRadix(num, base, level - 1, out, false);
+	}
+	LN high;
+	LN low;
+	Div(&high, &low, num, power);
+	out = WriteRadix(high, base, level - 1, out, pad);
+	return WriteRadix(low, base, level - 1, out, true);
+}
+
+std::string LN::ToString(unsigned base) const
+{
+	CheckBase(base);
+	if (base == 16 || is_nan_ || data_.get_size() == 0)
+	{
+		return ToString();
+	}
+
+	// the level whose power squared exceeds the number
+	size_t level = 0;
+	if (data_.get_size() > leaf_chunks || abs_compare(RadixPower(base, 0)) != std::strong_ordering::less)
+	{
+		while (BitLength() + 1 >= 2 * RadixPower(base, level).BitLength())
+		{
+			++level;
+		}
+		++level;
+	}
+
+	// a bound on the length; the number needs at most one digit per
+	// log2(base) bits
+	size_t bound = static_cast< size_t >(static_cast< double >(BitLength()) / std::log2(base)) + 3;
+	std::string result(bound, '\0');
+	char *out = result.data();
+	if (sign_ == -1)
+	{
+		*out++ = '-';
+	}
+	out = WriteRadix(*this, base, level, out, false);
+	result.resize(out - result.data());
+	return result;
+}
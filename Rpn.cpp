@@ -0,0 +1,197 @@
+#include "Rpn.h"
+
+#include <array>
+#include <utility>
+
+namespace
+{
+	struct NamedOperation
+	{
+		std::string_view token;
+		RpnOperation op;
+	};
+
+	LN Truth(bool value)
+	{
+		return LN(static_cast< long long >(value));
+	}
+
+	// the first operand is the top of the stack, as it always was
+	constexpr std::array operations = {
+		NamedOperation{ "+", { 2, 1, [](LN *a, LN *r) { r[0] = std::move(a[0]) + std::move(a[1]); } } },
+		NamedOperation{ "-", { 2, 1, [](LN *a, LN *r) { r[0] = std::move(a[0]) - std::move(a[1]); } } },
+		NamedOperation{ "*", { 2, 1, [](LN *a, LN *r) { r[0] = a[0] * a[1]; } } },
+		NamedOperation{ "/", { 2, 1, [](LN *a, LN *r) { r[0] = a[0] / a[1]; } } },
+		NamedOperation{ "%", { 2, 1, [](LN *a, LN *r) { r[0] = a[0] % a[1]; } } },
+		// quotient, then the remainder on top
+		NamedOperation{ "/%", { 2, 2, [](LN *a, LN *r) { LN::DivMod(a[0], a[1], r[0], r[1]); } } },
+		NamedOperation{ "!=", { 2, 1, [](LN *a, LN *r) { r[0] = Truth(a[0] != a[1]); } } },
+		NamedOperation{ "==", { 2, 1, [](LN *a, LN *r) { r[0] = Truth(a[0] == a[1]); } } },
+		NamedOperation{ ">=", { 2, 1, [](LN *a, LN *r) { r[0] = Truth(a[0] >= a[1]); } } },
+		NamedOperation{ "<=", { 2, 1, [](LN *a, LN *r) { r[0] = Truth(a[0] <= a[1]); } } },
+		NamedOperation{ "<", { 2, 1, [](LN *a, LN *r) { r[0] = Truth(a[0] < a[1]); } } },
+		NamedOperation{ ">", { 2, 1, [](LN *a, LN *r) { r[0] = Truth(a[0] > a[1]); } } },
+		NamedOperation{ "_", { 1, 1, [](LN *a, LN *r) { r[0] = -std::move(a[0]); } } },
+		NamedOperation{ "~", { 1, 1, [](LN *a, LN *r) { r[0] = ~a[0]; } } },
+		// base on top, then the exponent, then the modulus
+		NamedOperation{ "^%", { 3, 1, [](LN *a, LN *r) { r[0] = LN::PowMod(a[0], a[1], a[2]); } } },
+	};
+}	 // namespace
+
+const RpnOperation *FindRpnOperation(std::string_view token)
+{
+	for (const NamedOperation &named : operations)
+	{
+		if (named.token == token)
+		{
+			return &named.op;
+		}
+	}
+	return nullptr;
+}
+
+bool ApplyRpnOperation(std::stack< LN > &stack, const RpnOperation &op)
+{
+	if (stack.size() < op.arity)
+	{
+		return false;
+	}
+	// the operands are moved off the stack, so op may reuse their buffers
+	LN args[RpnOperation::max_arity];
+	for (unsigned i = 0; i < op.arity; ++i)
+	{
+		args[i] = std::move(stack.top());
+		stack.pop();
+	}
+	LN results[2];
+	op.apply(args, results);
+	for (unsigned i = 0; i < op.results; ++i)
+	{
+		stack.push(std::move(results[i]));
+	}
+	return true;
+}
+
+void RpnDag::AddValue(LN value)
+{
+	Node &node = nodes_.emplace_back();
+	node.out[0] = std::move(value);
+	stack_.push_back({ nodes_.size() - 1, 0 });
+}
+
+bool RpnDag::AddOperation(const RpnOperation &op)
+{
+	if (stack_.size() < op.arity)
+	{
+		return false;
+	}
+	size_t index = nodes_.size();
+	Node &node = nodes_.emplace_back();
+	node.op = &op;
+	for (unsigned i = 0; i < op.arity; ++i)
+	{
+		Ref arg = stack_.back();
+		stack_.pop_back();
+		node.args[i] = arg;
+		nodes_[arg.node].consumers[arg.slot] = index;
+	}
+	for (unsigned i = 0; i < op.results; ++i)
+	{
+		stack_.push_back({ index, i });
+	}
+	return true;
+}
+
+void RpnDag::Evaluate(ThreadPool &pool, std::stack< LN > &stack)
+{
+	// values are ready from the start, an operation waits for every operand
+	// that another operation produces
+	size_t operations = 0;
+	for (Node &node : nodes_)
+	{
+		if (node.op == nullptr)
+		{
+			continue;
+		}
+		++operations;
+		unsigned missing = 0;
+		for (unsigned i = 0; i < node.op->arity; ++i)
+		{
+			missing += nodes_[node.args[i].node].op != nullptr;
+		}
+		node.missing = missing;
+	}
+	remaining_ = operations;
+	// collected before any runs, a running node makes others ready as well
+	std::vector< size_t > ready;
+	for (size_t i = 0; i < nodes_.size(); ++i)
+	{
+		if (nodes_[i].op != nullptr && nodes_[i].missing == 0)
+		{
+			ready.push_back(i);
+		}
+	}
+	for (size_t i : ready)
+	{
+		pool.Submit([this, &pool, i] { Run(pool, i); });
+	}
+	pool.WaitUntil([this] { return remaining_ == 0; });
+
+	if (error_)
+	{
+		std::rethrow_exception(error_);
+	}
+	for (const Ref &ref : stack_)
+	{
+		stack.push(std::move(nodes_[ref.node].out[ref.slot]));
+	}
+}
+
+void RpnDag::Run(ThreadPool &pool, size_t index)
+{
+	while (true)
+	{
+		Node &node = nodes_[index];
+		// after a failure the remaining nodes only pass the readiness on
+		if (!failed_)
+		{
+			try
+			{
+				LN args[RpnOperation::max_arity];
+				for (unsigned i = 0; i < node.op->arity; ++i)
+				{
+					args[i] = std::move(nodes_[node.args[i].node].out[node.args[i].slot]);
+				}
+				node.op->apply(args, node.out);
+			} catch (...)
+			{
+				if (!failed_.exchange(true))
+				{
+					error_ = std::current_exception();
+				}
+			}
+		}
+
+		// the last consumer made ready runs right here, the others are queued
+		size_t next = none_;
+		for (unsigned i = 0; i < node.op->results; ++i)
+		{
+			size_t consumer = node.consumers[i];
+			if (consumer == none_ || --nodes_[consumer].missing != 0)
+			{
+				continue;
+			}
+			if (next != none_)
+			{
+				pool.Submit([this, &pool, next] { Run(pool, next); });
+			}
+			next = consumer;
+		}
+		--remaining_;
+		if (next == none_)
+		{
+			return;
+		}
+		index = next;
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "LN.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <stack>
+#include <string_view>
+#include <vector>
+
+// An operator of the RPN language. args[0] is the top of the stack and all
+// args may be moved from; results[0] is pushed first.
+struct RpnOperation
+{
+	static constexpr unsigned max_arity = 3;
+
+	unsigned arity;
+	unsigned results;
+	void (*apply)(LN *args, LN *results);
+};
+
+// nullptr if token is not an operator
+const RpnOperation *FindRpnOperation(std::string_view token);
+
+// pops the operands, applies op and pushes the results; false if the stack
+// holds fewer than op.arity values
+bool ApplyRpnOperation(std::stack< LN > &stack, const RpnOperation &op);
+
+// A whole RPN program as a graph: every operator becomes a node fed by the
+// nodes that produced its operands. Evaluate runs the nodes whose operands
+// are ready on a thread pool, so independent subexpressions are computed
+// at the same time.
+class RpnDag
+{
+  public:
+	void AddValue(LN value);
+	// false if there are fewer than op.arity values to take
+	bool AddOperation(const RpnOperation &op);
+
+	// computes the program and pushes what is left on its stack, bottom
+	// first; rethrows the first exception an operation threw
+	void Evaluate(ThreadPool &pool, std::stack< LN > &stack);
+
+  private:
+	static constexpr size_t none_ = static_cast< size_t >(-1);
+
+	// output slot of a node
+	struct Ref
+	{
+		size_t node;
+		unsigned slot;
+	};
+
+	struct Node
+	{
+		// nullptr for a value known from the start
+		const RpnOperation *op = nullptr;
+		Ref args[RpnOperation::max_arity] = {};
+		size_t consumers[2] = { none_, none_ };
+		std::atomic< unsigned > missing{ 0 };
+		LN out[2];
+	};
+
+	// a deque keeps the nodes in place, they are not movable
+	std::deque< Node > nodes_;
+	std::vector< Ref > stack_;
+
+	std::atomic< size_t > remaining_{ 0 };
+	std::atomic< bool > failed_{ false };
+	std::exception_ptr error_;
+
+	// runs node, then the consumers it makes ready
+	void Run(ThreadPool &pool, size_t node);
+};
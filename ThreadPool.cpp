@@ -0,0 +1,124 @@
+#include "ThreadPool.h"
+
+namespace
+{
+	thread_local ThreadPool *current_pool = nullptr;
+	thread_local size_t current_queue = 0;
+}	 // namespace
+
+ThreadPool::ThreadPool(size_t threads)
+{
+	size_t workers = threads > 1 ? threads - 1 : 0;
+	for (size_t i = 0; i <= workers; ++i)
+	{
+		queues_.push_back(std::make_unique< Queue >());
+	}
+	for (size_t i = 1; i <= workers; ++i)
+	{
+		workers_.emplace_back(&ThreadPool::Work, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard< std::mutex > lock(sleep_mutex_);
+		stop_ = true;
+	}
+	wake_.notify_all();
+	for (std::thread &worker : workers_)
+	{
+		worker.join();
+	}
+}
+
+size_t ThreadPool::Threads() const
+{
+	return workers_.size() + 1;
+}
+
+size_t ThreadPool::Self() const
+{
+	return current_pool == this ? current_queue : 0;
+}
+
+void ThreadPool::Submit(Task task)
+{
+	// counted first so that queued_ never drops below the tasks queued
+	++queued_;
+	Queue &queue = *queues_[Self()];
+	{
+		std::lock_guard< std::mutex > lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	// taking the lock orders this with a sleeper checking queued_
+	{
+		std::lock_guard< std::mutex > lock(sleep_mutex_);
+	}
+	wake_.notify_one();
+}
+
+bool ThreadPool::Take(size_t self, Task &task)
+{
+	{
+		Queue &own = *queues_[self];
+		std::lock_guard< std::mutex > lock(own.mutex);
+		if (!own.tasks.empty())
+		{
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+	for (size_t i = 1; i < queues_.size(); ++i)
+	{
+		Queue &victim = *queues_[(self + i) % queues_.size()];
+		std::lock_guard< std::mutex > lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ThreadPool::RunOne(size_t self)
+{
+	Task task;
+	if (!Take(self, task))
+	{
+		return false;
+	}
+	--queued_;
+	task();
+	// the task may have made the condition of a waiter true
+	if (waiting_ > 0)
+	{
+		{
+			std::lock_guard< std::mutex > lock(sleep_mutex_);
+		}
+		wake_.notify_all();
+	}
+	return true;
+}
+
+void ThreadPool::Work(size_t self)
+{
+	current_pool = this;
+	current_queue = self;
+	while (true)
+	{
+		if (RunOne(self))
+		{
+			continue;
+		}
+		std::unique_lock< std::mutex > lock(sleep_mutex_);
+		wake_.wait(lock, [this] { return queued_ > 0 || stop_; });
+		if (stop_ && queued_ == 0)
+		{
+			return;
+		}
+	}
+}
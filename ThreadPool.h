@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool. Every worker has its own deque: it takes its newest task
+// from the back and, when that is empty, steals the oldest task of another
+// deque from the front. Threads outside the pool share one more deque. A
+// thread waiting in WaitUntil runs tasks meanwhile, so ThreadPool(n) puts n
+// threads to work counting the one that waits.
+class ThreadPool
+{
+  public:
+	using Task = std::function< void() >;
+
+	explicit ThreadPool(size_t threads);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	// threads working for the pool, the waiting one included
+	size_t Threads() const;
+
+	// tasks must not throw
+	void Submit(Task task);
+
+	// runs tasks until done() holds; done must read atomics that the task
+	// making it true sets before it returns
+	template< typename FN >
+	void WaitUntil(FN &&done)
+	{
+		size_t self = Self();
+		while (!done())
+		{
+			if (RunOne(self))
+			{
+				continue;
+			}
+			std::unique_lock< std::mutex > lock(sleep_mutex_);
+			++waiting_;
+			wake_.wait(lock, [&] { return queued_ > 0 || done(); });
+			--waiting_;
+		}
+	}
+
+  private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque< Task > tasks;
+	};
+
+	// queues_[0] is for threads outside the pool, worker i has queues_[i]
+	std::vector< std::unique_ptr< Queue > > queues_;
+	std::vector< std::thread > workers_;
+	std::atomic< size_t > queued_{ 0 };
+	std::atomic< size_t > waiting_{ 0 };
+	std::mutex sleep_mutex_;
+	std::condition_variable wake_;
+	bool stop_ = false;
+
+	// the queue of the calling thread
+	size_t Self() const;
+	// runs one task, the own newest or a stolen oldest; false if none
+	bool RunOne(size_t self);
+	bool Take(size_t self, Task &task);
+	void Work(size_t self);
+};
@@ -1,130 +1,326 @@
+#include "Binary.h"
+#include "InputReader.h"
 #include "LN.h"
+#include "LimbMemory.h"
+#include "OutputWriter.h"
+#include "Rpn.h"
 #include "return_codes.h"
 
-template< typename FN >
-void ExecuteBinary(std::stack< LN > &state, FN &&func)
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct Options
 {
-	LN n1 = state.top();
-	state.pop();
-	LN n2 = state.top();
-	state.pop();
-	state.emplace(func(n1, n2));
-}
+	unsigned base = 16;
+	bool binary_output = false;
+	bool background_output = true;
+	const char *load = nullptr;
+	size_t jobs = 1;
+};
 
-template< typename FN >
-void ExecuteUnary(std::stack< LN > &state, FN &&func)
+struct Job
 {
-	LN n = state.top();
-	state.pop();
-	state.emplace(func(n));
-}
+	Job(std::string input, std::string output) : input(std::move(input)), output(std::move(output)) {}
 
-int main(int argc, char **argv)
+	std::string input;
+	std::string output;
+	int status = SUCCESS;
+	std::string messages;
+};
+
+// the program in job.input with its stack written to job.output; the limbs
+// come from arena, or with workers the program runs as a graph on them
+int Evaluate(const Job &job, const Options &options, BumpArena &arena, ThreadPool *workers, std::ostream &errors)
 {
-	if (argc != 3)
+	InputReader in(job.input.c_str());
+	if (!in.IsOpen())
 	{
-		std::cerr << "Number of parameters is incorrect" << std::endl;
-		return ERROR_PARAMETER_INVALID;
+		errors << "Error has occurred on ifstream" << std::endl;
+		return ERROR_CANNOT_OPEN_FILE;
 	}
-	try
+	// the numbers of this file take their limbs from a pool over the arena,
+	// declared first so that it outlives the stack; numbers of a graph move
+	// between threads and stay on the global heap
+	LimbPool pool(&arena);
+	std::optional< ResourceScope > limb_scope;
+	std::optional< RpnDag > dag;
+	if (workers != nullptr)
+	{
+		dag.emplace();
+	}
+	else
+	{
+		limb_scope.emplace(&pool);
+	}
+	std::stack< LN > numbers;
+	auto push = [&](LN &&value)
+	{
+		if (dag)
+		{
+			dag->AddValue(std::move(value));
+		}
+		else
+		{
+			numbers.push(std::move(value));
+		}
+	};
+
+	if (options.load != nullptr)
 	{
-		std::ifstream in(argv[1]);
-		if (in.bad() || in.fail())
+		// a stack saved with --binary, top first
+		InputReader saved(options.load);
+		if (!saved.IsOpen())
 		{
-			std::cerr << "Error has occurred on ifstream" << std::endl;
+			errors << "Error has occurred on ifstream" << std::endl;
 			return ERROR_CANNOT_OPEN_FILE;
 		}
-		std::string element;
-		std::stack< LN > numbers;
-		while (in >> element)
+		BinaryReader reader(saved.Contents());
+		std::vector< LN > values;
+		LN value;
+		while (reader.Next(value))
 		{
-			if (element == "+")
-			{
-				ExecuteBinary(numbers, [](const auto &n1, const auto &n2) { return n1 + n2; });
-			}
-			else if (element == "-")
-			{
-				ExecuteBinary(numbers, [](const auto &n1, const auto &n2) { return n1 - n2; });
-			}
-			else if (element == "/")
-			{
-				ExecuteBinary(numbers, [](const auto &n1, const auto &n2) { return n1 / n2; });
-			}
-			else if (element == "*")
-			{
-				ExecuteBinary(numbers, [](const auto &n1, const auto &n2) { return n1 * n2; });
-			}
-			else if (element == "%")
-			{
-				ExecuteBinary(numbers, [](const auto &n1, const auto &n2) { return n1 % n2; });
-			}
-			else if (element == "!=")
-			{
-				ExecuteBinary(numbers, [](const auto &n1, const auto &n2) { return n1 != n2; });
-			}
-			else if (element == "==")
-			{
-				ExecuteBinary(numbers, [](const auto &n1, const auto &n2) { return n1 == n2; });
-			}
-			else if (element == ">=")
-			{
-				ExecuteBinary(numbers, [](const auto &n1, const auto &n2) { return n1 >= n2; });
-			}
-			else if (element == "<=")
-			{
-				ExecuteBinary(numbers, [](const auto &n1, const auto &n2) { return n1 <= n2; });
-			}
-			else if (element == "<")
-			{
-				ExecuteBinary(numbers, [](const auto &n1, const auto &n2) { return n1 < n2; });
-			}
-			else if (element == ">")
-			{
-				ExecuteBinary(numbers, [](const auto &n1, const auto &n2) { return n1 > n2; });
-			}
-			else if (element == "_")
-			{
-				ExecuteUnary(numbers, [](const auto &n) { return -n; });
-			}
-			else if (element == "~")
-			{
-				ExecuteUnary(numbers, [](const auto &n) { return ~n; });
-			}
-			else
+			values.push_back(std::move(value));
+		}
+		if (!reader.IsValid())
+		{
+			errors << "Saved stack is damaged" << std::endl;
+			return ERROR_DATA_INVALID;
+		}
+		for (size_t i = values.size(); i-- > 0;)
+		{
+			push(std::move(values[i]));
+		}
+	}
+	std::string_view element;
+	while (in.Next(element))
+	{
+		if (const RpnOperation *op = FindRpnOperation(element))
+		{
+			if (dag ? !dag->AddOperation(*op) : !ApplyRpnOperation(numbers, *op))
 			{
-				numbers.emplace(element);
-				if (numbers.top().IsNaN())
-				{
-					std::cerr << "Invalid operation with NaN" << std::endl;
-					return ERROR_DATA_INVALID;
-				}
+				errors << "Not enough operands for " << element << std::endl;
+				return ERROR_DATA_INVALID;
 			}
+			continue;
 		}
-
-		std::ofstream out(argv[2]);
-		if (out.bad() || out.fail())
+		LN value = LN::FromString(element, options.base);
+		if (value.IsNaN())
 		{
-			std::cerr << "Error has occurred on ofstream" << std::endl;
-			return ERROR_CANNOT_OPEN_FILE;
+			errors << "Invalid operation with NaN" << std::endl;
+			return ERROR_DATA_INVALID;
 		}
-		while (!numbers.empty())
+		push(std::move(value));
+	}
+	if (dag)
+	{
+		dag->Evaluate(*workers, numbers);
+	}
+
+	std::ofstream out(job.output, options.binary_output ? std::ios::binary : std::ios::out);
+	if (out.bad() || out.fail())
+	{
+		errors << "Error has occurred on ofstream" << std::endl;
+		return ERROR_CANNOT_OPEN_FILE;
+	}
+	OutputWriter writer(out, options.background_output);
+	if (options.binary_output)
+	{
+		BinaryWriter binary(writer);
+		for (; !numbers.empty(); numbers.pop())
 		{
-			out << numbers.top().ToString() << std::endl;
-			numbers.pop();
+			binary.Write(numbers.top());
 		}
+	}
+	for (; !numbers.empty(); numbers.pop())
+	{
+		writer.WriteLine(numbers.top(), options.base);
+	}
+	if (!writer.Flush())
+	{
+		errors << "Error has occurred on ofstream" << std::endl;
+		return ERROR_CANNOT_OPEN_FILE;
+	}
+	return SUCCESS;
+}
+
+int Run(const Job &job, const Options &options, BumpArena &arena, ThreadPool *workers, std::ostream &errors)
+{
+	try
+	{
+		return Evaluate(job, options, arena, workers, errors);
 	} catch (const std::bad_alloc &)
 	{
-		std::cerr << "Error with memory allocation" << std::endl;
+		errors << "Error with memory allocation" << std::endl;
 		return ERROR_OUT_OF_MEMORY;
 	} catch (const std::domain_error &ex)
 	{
-		std::cerr << ex.what() << std::endl;
+		errors << ex.what() << std::endl;
 		return ERROR_DATA_INVALID;
 	} catch (...)
 	{
-		std::cerr << "Unknown error" << std::endl;
+		errors << "Unknown error" << std::endl;
 		return ERROR_UNKNOWN;
 	}
+}
 
-	return SUCCESS;
+// "input output" pairs of a manifest, or every file of a directory with its
+// result written next to it as <name>.out
+bool ReadJobs(const char *path, std::vector< Job > &jobs)
+{
+	std::error_code error;
+	if (std::filesystem::is_directory(path, error))
+	{
+		for (const auto &entry : std::filesystem::directory_iterator(path, error))
+		{
+			if (entry.is_regular_file() && entry.path().extension() != ".out")
+			{
+				jobs.emplace_back(entry.path().string(), entry.path().string() + ".out");
+			}
+		}
+		std::sort(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) { return a.input < b.input; });
+		return !error;
+	}
+	InputReader manifest(path);
+	if (!manifest.IsOpen())
+	{
+		return false;
+	}
+	std::string_view token;
+	while (manifest.Next(token))
+	{
+		// the token is only valid until the next call
+		std::string input(token);
+		if (!manifest.Next(token))
+		{
+			return false;
+		}
+		jobs.emplace_back(std::move(input), std::string(token));
+	}
+	return true;
+}
+
+// every job on the pool, each worker keeping one arena for all of its jobs;
+// prints the status of every job in order, the result is the first failure
+int RunBatch(const char *path, const Options &options)
+{
+	std::vector< Job > jobs;
+	if (!ReadJobs(path, jobs))
+	{
+		std::cerr << "Batch manifest can't be read" << std::endl;
+		return ERROR_CANNOT_OPEN_FILE;
+	}
+
+	// the jobs are the parallelism, the outputs are written on the worker
+	Options job_options = options;
+	job_options.background_output = false;
+	ThreadPool workers(options.jobs);
+	std::atomic< size_t > left{ jobs.size() };
+	for (Job &job : jobs)
+	{
+		workers.Submit(
+			[&job, &job_options, &left]
+			{
+				thread_local BumpArena arena;
+				std::ostringstream errors;
+				job.status = Run(job, job_options, arena, nullptr, errors);
+				arena.Reset();
+				job.messages = errors.str();
+				--left;
+			});
+	}
+	workers.WaitUntil([&left] { return left == 0; });
+
+	int status = SUCCESS;
+	for (const Job &job : jobs)
+	{
+		std::cout << job.status << ' ' << job.input << '\n';
+		if (!job.messages.empty())
+		{
+			std::cerr << job.input << ": " << job.messages;
+		}
+		if (status == SUCCESS)
+		{
+			status = job.status;
+		}
+	}
+	std::cout.flush();
+	return status;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc == 2 && std::string_view(argv[1]) == "--calibrate")
+	{
+		LN::Calibrate(std::cout);
+		return SUCCESS;
+	}
+	// options go before the input and output files
+	Options options;
+	const char *batch = nullptr;
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-')
+	{
+		std::string_view option(argv[arg++]);
+		if (option == "--base" && arg < argc)
+		{
+			options.base = static_cast< unsigned >(std::strtoul(argv[arg++], nullptr, 10));
+			if (options.base < 2 || options.base > 36)
+			{
+				std::cerr << "Base must be from 2 to 36" << std::endl;
+				return ERROR_PARAMETER_INVALID;
+			}
+		}
+		else if (option == "--binary")
+		{
+			options.binary_output = true;
+		}
+		else if (option == "--load" && arg < argc)
+		{
+			options.load = argv[arg++];
+		}
+		else if (option == "-j" && arg < argc)
+		{
+			// -j 0 takes every core
+			options.jobs = std::strtoul(argv[arg++], nullptr, 10);
+			if (options.jobs == 0)
+			{
+				options.jobs = std::max(1u, std::thread::hardware_concurrency());
+			}
+		}
+		else if (option == "--batch" && arg < argc)
+		{
+			// a manifest or a directory instead of the two files
+			batch = argv[arg++];
+		}
+		else
+		{
+			std::cerr << "Unknown option " << option << std::endl;
+			return ERROR_PARAMETER_INVALID;
+		}
+	}
+	if (argc - arg != (batch != nullptr ? 0 : 2))
+	{
+		std::cerr << "Number of parameters is incorrect" << std::endl;
+		return ERROR_PARAMETER_INVALID;
+	}
+	if (batch != nullptr)
+	{
+		return RunBatch(batch, options);
+	}
+
+	// shared by the graph of the program and by the large multiplications
+	std::optional< ThreadPool > workers;
+	if (options.jobs > 1)
+	{
+		workers.emplace(options.jobs);
+		LN::threads = &*workers;
+	}
+	BumpArena arena;
+	return Run(Job(argv[arg], argv[arg + 1]), options, arena, workers ? &*workers : nullptr, std::cerr);
 }